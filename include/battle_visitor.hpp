@@ -1,6 +1,10 @@
 #pragma once
+#include "npc.hpp"
 #include "visitor.hpp"
 
+// Может ли вид attacker убить вид victim при удачном броске
+bool canKill(Species attacker, Species victim);
+
 class BattleVisitor : public Visitor {
 public:
     BattleVisitor(NPC& other, std::vector<std::shared_ptr<Observer>>& observers, std::unordered_set<std::string>& killed, int attackRoll, int defenseRoll);
@@ -3,6 +3,6 @@
 
 class Bear : public NPC {
 public:
-    Bear(const std::string& name, double x, double y);
+    Bear(const std::string& name, double x, double y, const WorldBounds& bounds = {});
     void accept(Visitor& visitor) override;
 };
\ No newline at end of file
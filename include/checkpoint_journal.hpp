@@ -0,0 +1,80 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "npc.hpp"
+#include "npc_id_map.hpp"
+
+struct CheckpointConfig {
+    std::string directory = "checkpoints";
+    // Полный снимок раз в snapshotEvery тиков; между ними пишется только журнал
+    std::size_t snapshotEvery = 50;
+};
+
+// Инкрементальные контрольные точки: каждый тик в журнал дописываются
+// изменения (появление, перемещение, смерть), периодически в фоне
+// пишется полный снимок. Восстановление — последний целый снимок плюс
+// хвост журнала. record/commitTick вызываются из одного потока.
+class CheckpointJournal {
+public:
+    explicit CheckpointJournal(const CheckpointConfig& config);
+    ~CheckpointJournal();
+
+    CheckpointJournal(const CheckpointJournal&) = delete;
+    CheckpointJournal& operator=(const CheckpointJournal&) = delete;
+
+    // Сравнивает NPC с последним записанным состоянием и копит изменения тика
+    void record(const NPC& npc);
+    // Дописывает изменения тика в журнал; при необходимости запускает снимок
+    void commitTick(std::uint64_t tick);
+    // Запустит ли снимок следующий commitTick
+    bool snapshotDue() const { return ticksSinceSnapshot_ + 1 >= config_.snapshotEvery; }
+    // Дожидается фонового снимка
+    void flush();
+    // Начинает новую сессию: мир будет записан заново со следующего тика
+    void reset();
+
+    static std::vector<std::unique_ptr<NPC>> restore(const std::string& directory, const WorldBounds& bounds, std::uint64_t* lastTick = nullptr);
+
+private:
+    struct Identity {
+        std::string type;
+        std::string name;
+    };
+
+    struct State {
+        double x;
+        double y;
+        bool alive;
+    };
+
+    // Имена и типы не меняются: блоки фиксированного размера разделяются
+    // со снимком без копирования, копируются только позиции
+    static constexpr std::size_t IDENTITY_BLOCK = 4096;
+    using IdentityBlock = std::array<Identity, IDENTITY_BLOCK>;
+
+    CheckpointConfig config_;
+    std::uint64_t generation_{0};
+    std::ofstream journal_;
+    std::vector<char> pending_;
+
+    NpcIdMap ids_;
+    std::vector<std::shared_ptr<IdentityBlock>> identities_;
+    std::vector<State> states_;
+    std::size_t ticksSinceSnapshot_{0};
+
+    std::thread snapshotThread_;
+    std::atomic<bool> snapshotRunning_{false};
+
+    void openJournal(bool reset);
+    void startSnapshot(std::uint64_t tick);
+    static void writeSnapshot(const std::string& directory, std::uint64_t generation, std::uint64_t tick,
+                              std::vector<std::shared_ptr<IdentityBlock>> identities, std::vector<State> states);
+};
@@ -4,6 +4,6 @@
 // Выхухоль
 class Desman : public NPC {
 public:
-    Desman(const std::string& name, double x, double y);
+    Desman(const std::string& name, double x, double y, const WorldBounds& bounds = {});
     void accept(Visitor& visitor) override;
 };
\ No newline at end of file
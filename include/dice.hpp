@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+
+class NPC;
+
+// Перемешивание 64-битного значения (splitmix64)
+std::uint64_t mixSeed(std::uint64_t value);
+
+// Детерминированные броски атаки и защиты: зависят только от зерна, раунда
+// и упорядоченной пары, поэтому не зависят от порядка и места вычисления
+// Зерно собственных бросков NPC в раунде, например для шага движения
+std::uint64_t npcSeed(std::uint64_t seed, std::uint64_t round, const NPC& npc);
+
+std::pair<int, int> pairDice(std::uint64_t seed, std::uint64_t round, const NPC& attacker, const NPC& defender);
@@ -1,6 +1,10 @@
 #pragma once
 #include <atomic>
+#include <chrono>
+#include <compare>
 #include <condition_variable>
+#include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
@@ -10,46 +14,208 @@
 #include <thread>
 #include <vector>
 
+#include "checkpoint_journal.hpp"
+#include "map_renderer.hpp"
 #include "npc.hpp"
 #include "observer.hpp"
+#include "profiled_mutex.hpp"
+#include "region_snapshot.hpp"
+#include "thread_pool.hpp"
+#include "tick_pacer.hpp"
+#include "trajectory_recorder.hpp"
+
+// Поиск пар соседей: сетка чанков или сортировка по x (sweep and prune).
+// Сетка хороша при равномерном мире, сортировка — при плотных скоплениях
+enum class Broadphase { Grid, SweepAndPrune };
+
+// Параметры мира, задаваемые при создании подземелья
+struct DungeonConfig {
+    WorldBounds bounds{};
+    double chunkSize = 10.0;
+    PacingConfig pacing{};
+    // Сколько боёв battleLoop забирает из очереди за один захват блокировок
+    std::size_t fightBatch = 256;
+    Broadphase broadphase = Broadphase::Grid;
+    // Сторона области в снимке для ленивой загрузки (saveRegionSnapshot)
+    double snapshotRegionSize = 100.0;
+};
 
 class Dungeon {
 public:
     Dungeon();
+    explicit Dungeon(const DungeonConfig& config);
+
+    const DungeonConfig& config() const { return config_; }
 
     void addNPC(std::unique_ptr<NPC> npc);
     void spawnRandomNPCs(std::size_t count);
     void saveToFile(const std::string& filename) const;
     std::size_t loadFromFile(const std::string& filename);
+
+    // Ленивый мир: при загрузке читается только оглавление снимка, NPC области
+    // строятся при первом обращении. Запросы (карта — по видимой области) видят
+    // спящие NPC и просят их разбудить; movementLoop будит построенные фоном
+    // области в пределах дальности боя от живых NPC, не читая файл сам
+    void saveRegionSnapshot(const std::string& filename) const;
+    std::size_t loadLazy(const std::string& filename);
+    // Сколько областей снимка ещё не перенесено в мир
+    std::size_t dormantRegions() const;
+
+    // Инкрементальные контрольные точки: movementLoop пишет журнал каждый тик
+    void setJournal(std::shared_ptr<CheckpointJournal> journal);
+    void recordCheckpoint();
+    std::size_t restoreCheckpoint(const std::string& directory);
+    // Траектории: movementLoop снимает кадр раз в sampleEvery тиков
+    void setTrajectoryRecorder(std::shared_ptr<TrajectoryRecorder> recorder);
     void print() const;
     void printMap() const;
+    void setRenderConfig(const RenderConfig& config);
     void battle(double range, std::vector<std::shared_ptr<Observer>>& observers);
+    // Параллельный бой на пуле из threads потоков; при фиксированном seed
+    // результат не зависит от числа потоков
+    void battle(double range, std::vector<std::shared_ptr<Observer>>& observers, std::size_t threads, std::uint64_t seed);
 
     std::thread startMovementThread(std::atomic<bool>& stopFlag);
     std::thread startBattleThread(std::atomic<bool>& stopFlag, std::vector<std::shared_ptr<Observer>> observers);
     void notifyBattleThread();
 
     std::vector<std::string> survivors() const;
+    std::size_t populatedChunks() const;
+    // Номер текущего тика движения
+    std::uint64_t tick() const;
+    std::size_t fightQueueDepth() const;
+    // Сколько NPC на последнем тике спали: рядом не было никого, с кем возможен бой
+    std::size_t sleepingNPCs() const;
+    PacingStats pacingStats() const;
+
+    // Профиль ожидания и удержания блокировок по местам захвата; по умолчанию выключен
+    void enableLockProfiling(bool enabled = true);
+    std::vector<LockSiteStats> lockProfile() const;
+    void dumpLockProfile(std::ostream& out) const;
+
+    // Пошаговый интерфейс для внешних планировщиков (см. PartitionedDungeon)
+    void moveAll(std::mt19937& rng);
+    // Шаг NPC зависит только от зерна, раунда и имени: итог не зависит от разбиения мира
+    void moveAll(std::uint64_t seed, std::uint64_t round);
+    // Один тик movementLoop без паузы: движение, журнал, поиск и постановка боёв
+    void movementTick(std::mt19937& rng);
+    std::vector<std::unique_ptr<NPC>> extractIf(const std::function<bool(const NPC&)>& predicate);
+    void forEachAlive(const std::function<void(NPC&)>& fn);
+    void forEachPairInRange(double range, const std::function<void(NPC&, NPC&)>& fn);
+    double maxKillDistance() const;
 
 private:
     struct FightTask {
         NPC* attacker;
         NPC* defender;
+        std::chrono::steady_clock::time_point enqueuedAt;
+    };
+
+    struct ChunkCoord {
+        int x;
+        int y;
+        auto operator<=>(const ChunkCoord&) const = default;
+    };
+
+    // Чанк владеет своими NPC; пустые чанки не хранятся.
+    // species и маски пересчитываются перед поиском пар (updateInterestLocked)
+    struct Chunk {
+        std::vector<std::unique_ptr<NPC>> npcs;
+        std::vector<std::uint8_t> species;
+        // Виды живых NPC в чанке и в чанках в пределах радиуса поиска
+        std::uint8_t present{0};
+        std::uint8_t nearby{0};
+    };
+
+    using ChunkMap = std::map<ChunkCoord, Chunk>;
+
+    // Живой NPC в списке, отсортированном по x; координаты закэшированы
+    struct SweepEntry {
+        double x;
+        double y;
+        NPC* npc;
+        std::uint8_t species;
     };
 
-    std::vector<std::unique_ptr<NPC>> npcs_;
-    mutable std::shared_mutex npcsMutex_;
+    DungeonConfig config_;
+    ChunkMap chunks_;
+    // Убитые NPC остаются живыми объектами: на них могут ссылаться FightTask
+    std::vector<std::unique_ptr<NPC>> graveyard_;
+    double maxKillDistance_{0.0};
+    std::vector<SweepEntry> sweep_;
+    // Состав мира изменился не движением: список строится заново
+    bool sweepDirty_{true};
+    mutable ProfiledSharedMutex npcsMutex_{"npcsMutex_"};
 
     std::queue<FightTask> fights_;
-    std::mutex queueMutex_;
-    std::condition_variable queueCv_;
+    mutable ProfiledMutex queueMutex_{"queueMutex_"};
+    std::condition_variable_any queueCv_;
+    TickPacer pacer_;
 
-    mutable std::mutex coutMutex_;
+    mutable ProfiledMutex coutMutex_{"coutMutex_"};
+    mutable std::unique_ptr<MapRenderer> renderer_;
+    mutable std::uint64_t renderedVersion_{UINT64_MAX};
+    // Растёт при любом изменении мира; карта не перерисовывается без изменений
+    std::atomic<std::uint64_t> worldVersion_{0};
     std::mt19937 rng_;
+    std::unique_ptr<ThreadPool> battlePool_;
+
+    std::shared_ptr<CheckpointJournal> journal_;
+    // Изменения тика и их фиксация в журнале идут парой: иначе movementLoop
+    // и recordCheckpoint перемешали бы свои тики
+    mutable ProfiledMutex journalMutex_{"journalMutex_"};
+    std::size_t journaledGraveyard_{0};
+    std::shared_ptr<TrajectoryRecorder> trajectory_;
+    std::size_t recordedGraveyard_{0};
+    std::atomic<std::uint64_t> tick_{0};
+    std::atomic<std::size_t> sleeping_{0};
+    // shared_ptr: области строятся вне блокировки мира по копии указателя.
+    // Состояние LazyRegions синхронизировано само, константные запросы меняют его
+    std::shared_ptr<LazyRegions> lazy_;
+    std::atomic<bool> lazyPending_{false};
 
     void movementLoop(std::atomic<bool>& stopFlag);
     void battleLoop(std::atomic<bool>& stopFlag, std::vector<std::shared_ptr<Observer>> observers);
-    void enqueueFight(NPC* attacker, NPC* defender);
+    void enqueueFights(const std::vector<FightTask>& batch);
     bool tryPopFight(FightTask& task);
     void randomStep(NPC& npc, std::mt19937& rng);
+
+    ChunkCoord chunkOf(double x, double y) const;
+    void insertLocked(std::unique_ptr<NPC> npc);
+    void moveAllLocked(std::mt19937& rng, TrajectoryRecorder* frame = nullptr);
+    template <typename StepFn>
+    void moveEachLocked(StepFn&& step, TrajectoryRecorder* frame);
+    void recordCheckpointLocked();
+    void finishTrajectoryFrameLocked();
+    void replaceAllLocked(std::vector<std::unique_ptr<NPC>> npcs);
+    void materializeLocked(RegionKey key);
+    // Вызывать под journalMutex_, но без блокировки мира
+    void prepareLazy();
+    // Будит области в пределах дальности боя от чанков мира и запрошенные
+    void materializeTouchedLocked();
+    void materializeAllLocked();
+    // Строит спящие области в area (nullptr — все) и просит movementLoop их
+    // разбудить; до того forEachNPC обходит их NPC. Вызывать без блокировки мира
+    void requestLazy(const Viewport* area) const;
+    void retireLazyLocked();
+    int chunkReach(double range) const;
+    bool scansAllChunks(int reach) const;
+    void updateInterestLocked(int reach, bool scanAllChunks);
+    void refreshSweepLocked();
+    template <typename PairFn>
+    void forEachSweepPair(double range, PairFn&& fn);
+    template <typename ChunkFn>
+    void forEachNeighbourChunk(ChunkMap::iterator itA, int reach, bool scanAllChunks, ChunkFn&& fn);
+    template <typename PairFn>
+    void forEachPairFromChunk(ChunkMap::iterator itA, int reach, bool scanAllChunks, PairFn&& fn);
+    template <typename PairFn>
+    void forEachPairInChunk(Chunk& chunk, PairFn&& fn);
+    template <typename PairFn>
+    void forEachPairBetween(Chunk& first, Chunk& second, PairFn&& fn);
+    template <typename PairFn>
+    void forEachCandidatePair(double range, PairFn&& fn);
+    template <typename PairFn>
+    void forEachHostilePair(double range, PairFn&& fn);
+    template <typename NpcFn>
+    void forEachNPC(NpcFn&& fn) const;
 };
\ No newline at end of file
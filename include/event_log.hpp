@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "npc.hpp"
+#include "observer.hpp"
+
+struct KillRecord {
+    std::uint64_t tick;
+    std::uint64_t killerId;
+    std::uint64_t victimId;
+    Species killerSpecies;
+    Species victimSpecies;
+    float x;
+    float y;
+};
+
+// Двоичный журнал событий. Каждая запись — байт длины и тело: вид записи,
+// виды NPC и позиция жертвы фиксированной ширины, затем varint-дельты тика
+// и идентификаторов. Имя NPC пишется один раз отдельной записью.
+// Запись буферизуется; файл можно читать, пока он пишется.
+class BinaryEventLog : public Observer {
+public:
+    explicit BinaryEventLog(const std::string& filename, std::function<std::uint64_t()> tickSource = {}, std::size_t bufferSize = 1 << 16);
+    ~BinaryEventLog() override;
+
+    BinaryEventLog(const BinaryEventLog&) = delete;
+    BinaryEventLog& operator=(const BinaryEventLog&) = delete;
+
+    void onKill(const std::string& killer, const std::string& victim) override;
+    void onKillEvent(const NPC& killer, const NPC& victim) override;
+    void flush();
+
+private:
+    std::FILE* file_;
+    std::function<std::uint64_t()> tickSource_;
+    std::size_t bufferSize_;
+    std::vector<char> buffer_;
+    std::unordered_map<std::string, std::uint64_t> ids_;
+    std::uint64_t lastTick_{0};
+    std::uint64_t lastKillerId_{0};
+    std::mutex mutex_;
+
+    std::uint64_t idFor(const std::string& name);
+    void append(Species killer, Species victim, std::uint64_t killerId, std::uint64_t victimId, float x, float y);
+    void flushLocked();
+};
+
+// Потоковое чтение журнала. poll() разбирает всё, что уже дописано, и
+// оставляет неполную последнюю запись до следующего вызова.
+class EventLogReader {
+public:
+    explicit EventLogReader(const std::string& filename);
+    ~EventLogReader();
+
+    EventLogReader(const EventLogReader&) = delete;
+    EventLogReader& operator=(const EventLogReader&) = delete;
+
+    std::size_t poll(const std::function<void(const KillRecord&)>& fn);
+    const std::string& nameOf(std::uint64_t id) const;
+
+private:
+    std::FILE* file_;
+    std::vector<char> pending_;
+    std::vector<std::string> names_;
+    bool headerRead_{false};
+    std::uint64_t tick_{0};
+    std::uint64_t killerId_{0};
+};
@@ -3,10 +3,10 @@
 #include <string>
 #include <vector>
 
-class NPC;
+#include "npc.hpp"
 
 class NPCFactory {
 public:
-    static std::unique_ptr<NPC> createNPC(const std::string& type, const std::string& name, double x, double y);
-    static std::vector<std::unique_ptr<NPC>> loadFromFile(const std::string& filename);
+    static std::unique_ptr<NPC> createNPC(const std::string& type, const std::string& name, double x, double y, const WorldBounds& bounds = {});
+    static std::vector<std::unique_ptr<NPC>> loadFromFile(const std::string& filename, const WorldBounds& bounds = {});
 };
\ No newline at end of file
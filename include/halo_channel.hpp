@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+
+class NPC;
+
+// Запись фиксированного размера, которой обмениваются соседние полосы мира
+struct NPCRecord {
+    // Killer и следующий за ним Victim — убийство в полосе-процессе для наблюдателей родителя
+    enum Kind : std::uint8_t { Migrant, Halo, EndOfPhase, Survivor, EndOfResults, Killer, Victim };
+
+    static constexpr std::size_t TYPE_SIZE = 16;
+    static constexpr std::size_t NAME_SIZE = 48;
+
+    std::uint64_t tick{0};
+    double x{0.0};
+    double y{0.0};
+    Kind kind{Migrant};
+    char type[TYPE_SIZE]{};
+    char name[NAME_SIZE]{};
+
+    static NPCRecord fromNPC(const NPC& npc, Kind kind, std::uint64_t tick);
+    static NPCRecord marker(Kind kind, std::uint64_t tick);
+};
+
+// Однонаправленный канал записей: один писатель, один читатель
+class HaloChannel {
+public:
+    virtual ~HaloChannel() = default;
+    virtual bool tryPush(const NPCRecord& record) = 0;
+    virtual bool tryPop(NPCRecord& record) = 0;
+};
+
+// Кольцевой буфер в разделяемой памяти; создаётся до fork и виден обоим процессам
+class SharedMemoryRing : public HaloChannel {
+public:
+    explicit SharedMemoryRing(std::size_t capacity);
+    ~SharedMemoryRing() override;
+
+    SharedMemoryRing(const SharedMemoryRing&) = delete;
+    SharedMemoryRing& operator=(const SharedMemoryRing&) = delete;
+
+    bool tryPush(const NPCRecord& record) override;
+    bool tryPop(NPCRecord& record) override;
+
+private:
+    struct Header {
+        std::atomic<std::uint64_t> head;
+        std::atomic<std::uint64_t> tail;
+    };
+
+    std::size_t capacity_;
+    std::size_t bytes_;
+    void* memory_;
+    Header* header_;
+    NPCRecord* slots_;
+};
+
+// Локальная замена сетевого транспорта: та же семантика внутри одного процесса
+class LocalChannel : public HaloChannel {
+public:
+    explicit LocalChannel(std::size_t capacity);
+
+    bool tryPush(const NPCRecord& record) override;
+    bool tryPop(NPCRecord& record) override;
+
+private:
+    std::size_t capacity_;
+    std::deque<NPCRecord> records_;
+    std::mutex mutex_;
+};
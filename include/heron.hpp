@@ -4,6 +4,6 @@
 // Выпь
 class Heron : public NPC {
 public:
-    Heron(const std::string& name, double x, double y);
+    Heron(const std::string& name, double x, double y, const WorldBounds& bounds = {});
     void accept(Visitor& visitor) override;
 };
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "npc.hpp"
+
+// Видимая область мира; нулевой размер — весь мир
+struct Viewport {
+    double x = 0.0;
+    double y = 0.0;
+    double width = 0.0;
+    double height = 0.0;
+};
+
+struct RenderConfig {
+    // Размер сетки в клетках; клетка покрывает viewport / columns x viewport / rows
+    int columns = 50;
+    int rows = 50;
+    Viewport viewport{};
+    // true — после первого кадра выводятся только изменённые строки с
+    // позиционированием курсора ANSI, а текст ниже карты прокручивается в
+    // отдельной области; false — целый кадр, если он изменился.
+    // Если терминал fd меньше кадра, рендер сам переходит на целые кадры
+    bool ansiDiff = false;
+    // Дескриптор вывода; отрицательный — кадр только собирается (frame())
+    int fd = 1;
+};
+
+// Рендер карты с постоянным буфером кадра. Кадр собирается в один
+// непрерывный буфер и выводится одним вызовом write.
+class MapRenderer {
+public:
+    explicit MapRenderer(const RenderConfig& config = {});
+    ~MapRenderer();
+
+    MapRenderer(const MapRenderer&) = delete;
+    MapRenderer& operator=(const MapRenderer&) = delete;
+
+    const RenderConfig& config() const { return config_; }
+    // Область мира, которую покрывает кадр
+    Viewport visibleArea(const WorldBounds& bounds) const;
+
+    void beginFrame(const WorldBounds& bounds);
+    void plot(double x, double y, char mark);
+    // Выводит отличия от прошлого кадра; возвращает число байт вывода
+    std::size_t present();
+
+    const std::string& frame() const { return out_; }
+
+private:
+    RenderConfig config_;
+    Viewport area_{};
+    std::vector<char> cells_;
+    std::vector<char> shown_;
+    bool firstFrame_{true};
+    std::string out_;
+
+    bool fitsTerminal() const;
+    void appendRow(int row);
+    void writeOut(const std::string& bytes) const;
+};
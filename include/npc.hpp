@@ -1,5 +1,7 @@
 #pragma once
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <stdexcept>
 
@@ -8,12 +10,27 @@
 
 class Visitor;
 
+// Размеры мира: координаты лежат в [0, width] x [0, height]
+struct WorldBounds {
+    static constexpr double DEFAULT_SIZE = 50.0;
+
+    double width = DEFAULT_SIZE;
+    double height = DEFAULT_SIZE;
+};
+
+// Вид NPC: определяется типом один раз при создании
+enum class Species : std::uint8_t { Bear, Heron, Desman, Unknown };
+constexpr std::size_t SPECIES_COUNT = static_cast<std::size_t>(Species::Unknown) + 1;
+
+Species speciesOf(const std::string& type);
+const char* speciesName(Species species);
+
 class NPC {
 public:
     static constexpr double MAP_MIN = 0.0;
-    static constexpr double MAP_MAX = 50.0;
+    static constexpr double MAP_MAX = WorldBounds::DEFAULT_SIZE;
 
-    NPC(const std::string& name, double x, double y, const std::string& type, double moveDistance, double killDistance);
+    NPC(const std::string& name, double x, double y, const std::string& type, double moveDistance, double killDistance, const WorldBounds& bounds = {});
     virtual ~NPC() = default;
 
     virtual void accept(Visitor& visitor) = 0;
@@ -22,10 +39,14 @@ public:
     double getX() const;
     double getY() const;
     const std::string& getType() const;
+    Species getSpecies() const;
 
     double getMoveDistance() const;
     double getKillDistance() const;
 
+    const WorldBounds& getBounds() const;
+    void setBounds(const WorldBounds& bounds);
+
     bool isAlive() const;
     void kill();
 
@@ -38,9 +59,12 @@ private:
     std::string name_;
     double x_, y_;
     std::string type_;
+    Species species_;
     double moveDistance_;
     double killDistance_;
+    WorldBounds bounds_;
     std::atomic<bool> alive_{true};
     
     void validateCoordinates(double x, double y) const;
+    static void validateCoordinates(double x, double y, const WorldBounds& bounds);
 };
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class NPC;
+
+// Идентификаторы NPC по адресу, подряд в порядке появления. Открытая адресация:
+// на миллионе NPC заметно быстрее std::unordered_map, поиск идёт каждый тик для каждого NPC
+class NpcIdMap {
+public:
+    // added — идентификатор выдан только что
+    std::uint32_t idOf(const NPC& npc, bool& added);
+    std::size_t size() const { return count_; }
+    void clear();
+
+private:
+    struct Slot {
+        const NPC* npc;
+        std::uint32_t id;
+    };
+
+    std::vector<Slot> slots_;
+    std::size_t count_{0};
+};
@@ -1,8 +1,12 @@
 #pragma once
 #include <string>
 
+class NPC;
+
 class Observer {
 public:
     virtual ~Observer() = default;
     virtual void onKill(const std::string& killer, const std::string& victim) = 0;
+    // Полные данные об убийстве; по умолчанию сводится к именам
+    virtual void onKillEvent(const NPC& killer, const NPC& victim);
 };
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dungeon.hpp"
+#include "halo_channel.hpp"
+#include "npc.hpp"
+#include "observer.hpp"
+
+struct PartitionConfig {
+    DungeonConfig dungeon{};
+    std::size_t workers = 2;
+    std::size_t ticks = 100;
+    std::uint64_t seed = 1;
+    // Ширина приграничной зоны; 0 — максимальная дальность убийства среди NPC
+    double haloWidth = 0.0;
+    std::size_t channelCapacity = 4096;
+    // true — полосы в отдельных процессах (fork + разделяемая память),
+    // false — в потоках с LocalChannel вместо межузлового транспорта
+    bool useProcesses = true;
+};
+
+// Мир, разрезанный на горизонтальные полосы, по одной на воркер.
+// Каждый тик соседи обмениваются мигрантами и приграничными NPC (halo);
+// все бои решаются по состоянию на начало тика детерминированными бросками,
+// поэтому итог совпадает с неразбитым миром при любом числе полос.
+class PartitionedDungeon {
+public:
+    explicit PartitionedDungeon(const PartitionConfig& config);
+
+    // Запускать до старта других потоков: в режиме процессов используется fork
+    std::vector<std::string> run(std::vector<std::unique_ptr<NPC>> npcs, std::vector<std::shared_ptr<Observer>> observers);
+
+private:
+    struct Links {
+        HaloChannel* fromDown{nullptr};
+        HaloChannel* toDown{nullptr};
+        HaloChannel* fromUp{nullptr};
+        HaloChannel* toUp{nullptr};
+        HaloChannel* results{nullptr};
+        const std::atomic<bool>* abort{nullptr};
+    };
+
+    PartitionConfig config_;
+    // Сколько полос на самом деле: не больше, чем помещается полос не ниже halo
+    std::size_t workers_;
+
+    std::size_t stripOf(double y) const;
+    double stripLow(std::size_t strip) const;
+    double stripHigh(std::size_t strip) const;
+
+    void runStrip(std::size_t strip, std::vector<std::unique_ptr<NPC>> npcs, const Links& links, double haloWidth, std::size_t hops, std::vector<std::shared_ptr<Observer>> observers) const;
+    void notifyKill(const NPCRecord& killer, const NPCRecord& victim, const std::vector<std::shared_ptr<Observer>>& observers) const;
+    void exchange(const Links& links, std::vector<NPCRecord> toDown, std::vector<NPCRecord> toUp, std::vector<NPCRecord>& incoming, std::uint64_t tick) const;
+};
@@ -0,0 +1,124 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+// Места захвата блокировок, по которым собирается статистика
+enum class LockSite : std::uint8_t { MovementLoop, BattleLoop, PrintMap, Survivors, AddNPC, SaveToFile, Pacing, Other };
+constexpr std::size_t LOCK_SITE_COUNT = static_cast<std::size_t>(LockSite::Other) + 1;
+const char* lockSiteName(LockSite site);
+
+// Помечает все захваты в текущем потоке до конца области видимости
+class LockSiteScope {
+public:
+    explicit LockSiteScope(LockSite site);
+    ~LockSiteScope();
+
+    LockSiteScope(const LockSiteScope&) = delete;
+    LockSiteScope& operator=(const LockSiteScope&) = delete;
+
+private:
+    LockSite previous_;
+};
+
+// Гистограммы по степеням двойки наносекунд: корзина i — [2^(i-1), 2^i)
+constexpr std::size_t LOCK_HISTOGRAM_BUCKETS = 40;
+
+struct LockSiteStats {
+    std::string mutex;
+    LockSite site;
+    std::uint64_t acquisitions;
+    std::chrono::nanoseconds totalWait;
+    std::chrono::nanoseconds totalHold;
+    std::array<std::uint64_t, LOCK_HISTOGRAM_BUCKETS> waitHistogram;
+    std::array<std::uint64_t, LOCK_HISTOGRAM_BUCKETS> holdHistogram;
+
+    // Верхняя граница корзины, в которую попадает квантиль q
+    std::chrono::nanoseconds waitPercentile(double q) const;
+    std::chrono::nanoseconds holdPercentile(double q) const;
+};
+
+// Счётчики одного мьютекса; профилирование включается явно
+class LockProfile {
+public:
+    explicit LockProfile(std::string name);
+
+    void setEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    void recordWait(LockSite site, std::chrono::nanoseconds wait);
+    void recordHold(LockSite site, std::chrono::nanoseconds hold);
+    std::vector<LockSiteStats> snapshot() const;
+
+private:
+    struct Counters {
+        std::atomic<std::uint64_t> acquisitions{0};
+        std::atomic<std::uint64_t> waitNs{0};
+        std::atomic<std::uint64_t> holdNs{0};
+        std::array<std::atomic<std::uint64_t>, LOCK_HISTOGRAM_BUCKETS> waitHistogram{};
+        std::array<std::atomic<std::uint64_t>, LOCK_HISTOGRAM_BUCKETS> holdHistogram{};
+    };
+
+    std::string name_;
+    std::atomic<bool> enabled_{false};
+    std::array<Counters, LOCK_SITE_COUNT> sites_;
+};
+
+// Замена std::mutex с подсчётом ожидания и удержания
+class ProfiledMutex {
+public:
+    explicit ProfiledMutex(std::string name);
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    LockProfile& profile() { return profile_; }
+    const LockProfile& profile() const { return profile_; }
+
+private:
+    std::mutex mutex_;
+    LockProfile profile_;
+    // Пишутся только владельцем блокировки
+    std::chrono::steady_clock::time_point acquiredAt_{};
+    LockSite holderSite_{LockSite::Other};
+    bool profiledHold_{false};
+
+    void acquired(std::chrono::steady_clock::time_point start);
+};
+
+// Замена std::shared_mutex с подсчётом ожидания и удержания
+class ProfiledSharedMutex {
+public:
+    explicit ProfiledSharedMutex(std::string name);
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    void lock_shared();
+    bool try_lock_shared();
+    void unlock_shared();
+
+    LockProfile& profile() { return profile_; }
+    const LockProfile& profile() const { return profile_; }
+
+private:
+    std::shared_mutex mutex_;
+    LockProfile profile_;
+    std::chrono::steady_clock::time_point acquiredAt_{};
+    LockSite holderSite_{LockSite::Other};
+    bool profiledHold_{false};
+
+    void acquired(std::chrono::steady_clock::time_point start);
+    void acquiredShared(std::chrono::steady_clock::time_point start);
+};
+
+void dumpLockStats(std::ostream& out, const std::vector<LockSiteStats>& stats);
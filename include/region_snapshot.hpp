@@ -0,0 +1,117 @@
+#pragma once
+#include <compare>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "npc.hpp"
+
+struct RegionKey {
+    int x;
+    int y;
+    auto operator<=>(const RegionKey&) const = default;
+};
+
+// Снимок мира, разложенный по квадратным областям. В начале файла —
+// оглавление «область → смещение», NPC области читаются только по запросу
+class RegionSnapshot {
+public:
+    struct Region {
+        RegionKey key;
+        std::uint32_t count;
+        std::uint64_t offset;
+        std::uint64_t size;
+    };
+
+    // Читает только заголовок и оглавление
+    explicit RegionSnapshot(const std::string& filename);
+
+    static void write(const std::string& filename, const std::vector<const NPC*>& npcs, double regionSize);
+    static bool isSnapshot(const std::string& filename);
+
+    double regionSize() const { return regionSize_; }
+    double maxKillDistance() const { return maxKillDistance_; }
+    const std::vector<Region>& regions() const { return regions_; }
+    std::size_t npcCount() const;
+    RegionKey regionOf(double x, double y) const;
+    // Строит NPC одной области; безопасно из разных потоков
+    std::vector<std::unique_ptr<NPC>> load(const Region& region, const WorldBounds& bounds) const;
+
+private:
+    std::string filename_;
+    double regionSize_{0.0};
+    double maxKillDistance_{0.0};
+    std::vector<Region> regions_;
+};
+
+// Области снимка, ещё не отданные миру. Область отдаётся, только когда к ней
+// обратились: запрос, движение или бой рядом. Фоновый поток заранее строит NPC
+// нужных областей и областей в двух досягаемостях боя от отданных, чтобы
+// соседи области, отданной на этом тике, тоже были готовы; остальные не читаются
+class LazyRegions {
+public:
+    using Loaded = std::vector<std::pair<RegionKey, std::vector<std::unique_ptr<NPC>>>>;
+
+    LazyRegions(std::shared_ptr<const RegionSnapshot> snapshot, const WorldBounds& bounds);
+    ~LazyRegions();
+
+    LazyRegions(const LazyRegions&) = delete;
+    LazyRegions& operator=(const LazyRegions&) = delete;
+
+    const RegionSnapshot& snapshot() const { return *snapshot_; }
+    // Сколько областей ещё не отдано
+    std::size_t dormant() const;
+    // NPC области: готовые из фона или построенные сразу. Повторно — пусто
+    std::vector<std::unique_ptr<NPC>> take(RegionKey key);
+    // Отдаёт уже построенные из keys и отмеченные want; недостроенные из keys
+    // отмечает сам. Чтения файла здесь нет
+    Loaded claim(const std::vector<RegionKey>& keys);
+    // Отмечает области нужными: фон строит их первыми, claim отдаст готовые
+    void want(const std::vector<RegionKey>& keys);
+    // Строит области сразу. Вызывать вне блокировки мира: здесь чтение файла
+    void prepare(const std::vector<RegionKey>& keys);
+    // То же для всех неотданных областей
+    void prepareAll();
+    // NPC построенных, но ещё не отданных областей
+    void forEachReady(const std::function<void(const NPC&)>& fn) const;
+
+private:
+    enum class State { Dormant, Loading, Ready, Taken };
+
+    struct Slot {
+        const RegionSnapshot::Region* region;
+        State state{State::Dormant};
+        bool wanted{false};
+        std::vector<std::unique_ptr<NPC>> npcs;
+    };
+
+    std::shared_ptr<const RegionSnapshot> snapshot_;
+    WorldBounds bounds_;
+    int reach_{1};
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::map<RegionKey, Slot> slots_;
+    std::size_t dormant_{0};
+    std::vector<RegionKey> wanted_;
+    // Очередь фона: нужные в начале, окрестности отданных в конце
+    std::deque<RegionKey> prefetch_;
+    bool stop_{false};
+    std::thread worker_;
+
+    void markTakenLocked(RegionKey key);
+    void wantLocked(RegionKey key);
+    // Строит область, если её ещё никто не строит; если строит другой поток — ждёт
+    void prepare(RegionKey key);
+    bool nextToLoadLocked(RegionKey& key);
+    void run();
+};
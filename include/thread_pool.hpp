@@ -0,0 +1,41 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Постоянный пул потоков для параллельных циклов по независимым задачам
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::size_t size() const { return workers_.size() + 1; }
+
+    // Выполняет fn(i) для всех i из [0, count) и ждёт завершения;
+    // вызывающий поток тоже участвует. Первое исключение пробрасывается.
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& fn);
+
+private:
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wakeCv_;
+    std::condition_variable doneCv_;
+
+    const std::function<void(std::size_t)>* job_{nullptr};
+    std::size_t jobSize_{0};
+    std::size_t nextIndex_{0};
+    std::size_t finished_{0};
+    std::size_t generation_{0};
+    std::exception_ptr error_;
+    bool stopping_{false};
+
+    void workerLoop();
+    void runTasks(std::unique_lock<std::mutex>& lock);
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+struct PacingConfig {
+    // Желаемая длительность тика движения и предел её растяжения
+    std::chrono::milliseconds targetTick{200};
+    std::chrono::milliseconds maxTick{2000};
+    // Ёмкость очереди боёв; лишние бои отбрасываются и найдутся следующим сканом
+    std::size_t queueCapacity = 65536;
+    // Доля ёмкости, при которой поиск соседей откладывается
+    double highWatermark = 0.5;
+    // Доля ёмкости, ниже которой бой считается успевающим
+    double lowWatermark = 0.1;
+};
+
+struct PacingStats {
+    std::uint64_t ticks{0};
+    std::uint64_t skippedScans{0};
+    std::uint64_t droppedFights{0};
+    std::chrono::milliseconds interval{0};
+    std::chrono::microseconds battleLatency{0};
+};
+
+// Адаптивный темп тиков: следит за глубиной очереди боёв и задержкой их
+// разбора, растягивает или сокращает интервал тика и откладывает поиск
+// соседей, пока бой не догонит движение.
+class TickPacer {
+public:
+    explicit TickPacer(const PacingConfig& config = {});
+
+    const PacingConfig& config() const { return config_; }
+
+    // Поток движения: нужен ли поиск соседей в этом тике
+    bool shouldScan(std::size_t queueDepth);
+    // Поток движения: сколько спать после тика, занявшего work
+    std::chrono::milliseconds nextInterval(std::chrono::nanoseconds work, std::size_t queueDepth);
+    // Поток боя: задержка от постановки боя в очередь до его разбора
+    void recordBattleLatency(std::chrono::nanoseconds latency);
+    void recordDropped(std::size_t fights);
+
+    PacingStats stats() const;
+
+private:
+    PacingConfig config_;
+    mutable std::mutex mutex_;
+    std::chrono::nanoseconds interval_;
+    double latencyEwma_{0.0};
+    PacingStats stats_{};
+
+    std::size_t watermark(double fraction) const;
+};
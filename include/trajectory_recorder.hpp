@@ -0,0 +1,128 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "npc.hpp"
+#include "npc_id_map.hpp"
+
+struct TrajectoryConfig {
+    std::string filename = "trajectory.bin";
+    // Кадр снимается раз в sampleEvery тиков
+    std::size_t sampleEvery = 1;
+    // Шаг квантования координат
+    double quantum = 1.0 / 64;
+    std::size_t framesPerBlock = 8;
+    // Сколько готовых блоков может ждать записи, прежде чем симуляция притормозит
+    std::size_t maxPendingBlocks = 2;
+};
+
+// Запись траекторий всех NPC. Кадры копятся в блоки; блок хранится по
+// столбцам: битовые маски живых по кадрам, затем для каждого NPC дельты
+// квантованных x по кадрам, затем так же y. Сжатие и запись — в фоновом
+// потоке. beginFrame/record/endFrame вызываются из одного потока и никогда
+// не ждут писателя: ожидание — в publish, вне блокировки мира.
+class TrajectoryRecorder {
+public:
+    explicit TrajectoryRecorder(const TrajectoryConfig& config = {});
+    ~TrajectoryRecorder();
+
+    TrajectoryRecorder(const TrajectoryRecorder&) = delete;
+    TrajectoryRecorder& operator=(const TrajectoryRecorder&) = delete;
+
+    const TrajectoryConfig& config() const { return config_; }
+    bool wantsTick(std::uint64_t tick) const { return tick % config_.sampleEvery == 0; }
+
+    void beginFrame(std::uint64_t tick);
+    void record(const NPC& npc);
+    void endFrame();
+    // Притормаживает вызывающего, пока очередь блоков на запись переполнена
+    void publish();
+    // Мир заменён целиком: идентификаторы выдаются заново
+    void reset();
+    // Дописывает неполный блок и дожидается записи на диск
+    void flush();
+
+private:
+    struct Identity {
+        std::string type;
+        std::string name;
+    };
+
+    struct Frame {
+        std::uint64_t tick;
+        std::vector<std::int32_t> x;
+        std::vector<std::int32_t> y;
+        std::vector<std::uint8_t> alive;
+        // Кого записали в этом кадре; остальным писатель подставит прошлые координаты
+        std::vector<std::uint8_t> written;
+    };
+
+    struct Block {
+        bool reset;
+        std::uint32_t firstNewId;
+        std::vector<Identity> identities;
+        std::vector<Frame> frames;
+        std::size_t npcCount;
+    };
+
+    TrajectoryConfig config_;
+    std::FILE* file_;
+
+    NpcIdMap ids_;
+    Frame current_{};
+    Block block_{};
+
+    std::deque<Block> pending_;
+    // Кадры, вернувшиеся от писателя: буферы переиспользуются, а не копируются
+    std::vector<Frame> spare_;
+    // Последние записанные координаты; только для потока писателя
+    std::vector<std::int32_t> lastX_;
+    std::vector<std::int32_t> lastY_;
+    bool writing_{false};
+    bool stop_{false};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread writer_;
+
+    void queueBlock();
+    void writerLoop();
+};
+
+struct TrajectoryFrame {
+    std::uint64_t tick;
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<bool> alive;
+};
+
+// Последовательное чтение файла траекторий по кадрам
+class TrajectoryReader {
+public:
+    explicit TrajectoryReader(const std::string& filename);
+    ~TrajectoryReader();
+
+    TrajectoryReader(const TrajectoryReader&) = delete;
+    TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+    bool next(TrajectoryFrame& frame);
+    std::size_t npcCount() const { return names_.size(); }
+    const std::string& nameOf(std::uint32_t id) const;
+    const std::string& typeOf(std::uint32_t id) const;
+
+private:
+    std::FILE* file_;
+    double quantum_{1.0};
+    std::vector<std::string> names_;
+    std::vector<std::string> types_;
+    std::vector<TrajectoryFrame> frames_;
+    std::size_t nextFrame_{0};
+
+    bool readBlock();
+};
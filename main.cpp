@@ -2,22 +2,28 @@
 #include "factory.hpp"
 #include "console_observer.hpp"
 #include "file_observer.hpp"
+#include "event_log.hpp"
 
 #include <atomic>
 #include <chrono>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <thread>
+#include <unistd.h>
 
 int main(int argc, char** argv) {
     using namespace std::chrono_literals;
 
     Dungeon dungeon;
+    const bool profileLocks = std::getenv("DUNGEON_LOCK_PROFILE") != nullptr;
+    dungeon.enableLockProfiling(profileLocks);
     auto consoleObs = std::make_shared<ConsoleObserver>();
     auto fileObs = std::make_shared<FileObserver>("log.txt");
-    std::vector<std::shared_ptr<Observer>> observers = {consoleObs, fileObs};
+    auto eventLog = std::make_shared<BinaryEventLog>("events.bin", [&dungeon]() { return dungeon.tick(); });
+    std::vector<std::shared_ptr<Observer>> observers = {consoleObs, fileObs, eventLog};
 
     std::cout << "=== Dungeon Simulation ===" << std::endl;
 
@@ -27,7 +33,16 @@ int main(int argc, char** argv) {
     if (argc > 1) {
         npcFile = argv[1];
         std::cout << "Loading NPCs from file: " << npcFile << std::endl;
-        auto loaded = dungeon.loadFromFile(npcFile);
+        // Снимок по областям загружается лениво: первый тик не ждёт постройки всего мира;
+        // каталог — контрольные точки прошлого запуска
+        std::size_t loaded = 0;
+        if (std::filesystem::is_directory(npcFile)) {
+            loaded = dungeon.restoreCheckpoint(npcFile);
+        } else if (RegionSnapshot::isSnapshot(npcFile)) {
+            loaded = dungeon.loadLazy(npcFile);
+        } else {
+            loaded = dungeon.loadFromFile(npcFile);
+        }
         if (loaded == 0) {
             std::cerr << "File has no valid NPC entries. Exiting." << std::endl;
             return 1;
@@ -39,6 +54,33 @@ int main(int argc, char** argv) {
         dungeon.saveToFile(npcFile);
     }
 
+    // Преобразование в снимок по областям для быстрого старта в следующий раз
+    if (const char* snapshotFile = std::getenv("DUNGEON_REGION_SNAPSHOT")) {
+        dungeon.saveRegionSnapshot(snapshotFile);
+    }
+
+    // Запись траекторий для офлайн-анализа включается переменной окружения
+    std::shared_ptr<TrajectoryRecorder> trajectory;
+    if (const char* trajectoryFile = std::getenv("DUNGEON_TRAJECTORY")) {
+        TrajectoryConfig trajectoryConfig;
+        trajectoryConfig.filename = trajectoryFile;
+        trajectory = std::make_shared<TrajectoryRecorder>(trajectoryConfig);
+        dungeon.setTrajectoryRecorder(trajectory);
+    }
+
+    // Инкрементальные контрольные точки, тоже по переменной окружения
+    std::shared_ptr<CheckpointJournal> journal;
+    if (const char* checkpointDirectory = std::getenv("DUNGEON_CHECKPOINTS")) {
+        CheckpointConfig checkpointConfig;
+        checkpointConfig.directory = checkpointDirectory;
+        journal = std::make_shared<CheckpointJournal>(checkpointConfig);
+        dungeon.setJournal(journal);
+    }
+
+    RenderConfig renderConfig;
+    renderConfig.ansiDiff = isatty(STDOUT_FILENO) != 0;
+    dungeon.setRenderConfig(renderConfig);
+
     std::atomic<bool> stopFlag{false};
     std::thread movementThread = dungeon.startMovementThread(stopFlag);
     std::thread battleThread = dungeon.startBattleThread(stopFlag, observers);
@@ -56,6 +98,13 @@ int main(int argc, char** argv) {
 
     if (movementThread.joinable()) movementThread.join();
     if (battleThread.joinable()) battleThread.join();
+    eventLog->flush();
+    if (trajectory) {
+        trajectory->flush();
+    }
+    if (journal) {
+        journal->flush();
+    }
 
     auto alive = dungeon.survivors();
     std::cout << "\n=== Survivors after 30 seconds ===" << std::endl;
@@ -64,5 +113,9 @@ int main(int argc, char** argv) {
     }
     std::cout << "Total survivors: " << alive.size() << std::endl;
 
+    if (profileLocks) {
+        dungeon.dumpLockProfile(std::cerr);
+    }
+
     return 0;
 }
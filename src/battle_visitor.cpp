@@ -4,14 +4,24 @@
 #include "desman.hpp"
 #include "observer.hpp"
 
+bool canKill(Species attacker, Species victim) {
+    switch (attacker) {
+        // Медведь ест всех кроме медведей
+        case Species::Bear: return victim != Species::Bear;
+        // Выхухоль убивает медведей
+        case Species::Desman: return victim == Species::Bear;
+        // Выпь никого не обижает
+        default: return false;
+    }
+}
+
 BattleVisitor::BattleVisitor(NPC& other, std::vector<std::shared_ptr<Observer>>& observers, std::unordered_set<std::string>& killed, int attackRoll, int defenseRoll)
     : Visitor(other, observers, killed, attackRoll, defenseRoll) {}
 
 void BattleVisitor::visitBear(Bear& bear) {
-    // Медведь ест всех кроме медведей
-    if (other_.getType() != "Bear" && attackWins()) {
+    if (canKill(Species::Bear, other_.getSpecies()) && attackWins()) {
         for (auto& obs : observers_) {
-            obs->onKill(bear.getName(), other_.getName());
+            obs->onKillEvent(bear, other_);
         }
         killed_.insert(other_.getName());
         killHappened_ = true;
@@ -23,10 +33,9 @@ void BattleVisitor::visitHeron(Heron& heron) {
 }
 
 void BattleVisitor::visitDesman(Desman& desman) {
-    // Выхухоль убивает медведей
-    if (other_.getType() == "Bear" && attackWins()) {
+    if (canKill(Species::Desman, other_.getSpecies()) && attackWins()) {
         for (auto& obs : observers_) {
-            obs->onKill(desman.getName(), other_.getName());
+            obs->onKillEvent(desman, other_);
         }
         killed_.insert(other_.getName());
         killHappened_ = true;
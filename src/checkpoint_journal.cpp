@@ -0,0 +1,372 @@
+#include "checkpoint_journal.hpp"
+#include "factory.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+enum RecordKind : std::uint8_t { Reset, Spawn, Move, Death, Commit };
+
+constexpr char SNAPSHOT_MAGIC[4] = {'D', 'S', 'N', 'P'};
+constexpr char SNAPSHOT_END[4] = {'D', 'E', 'N', 'D'};
+
+template <typename T>
+void put(std::vector<char>& out, const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void putString(std::vector<char>& out, const std::string& value) {
+    if (value.size() > UINT16_MAX) {
+        throw std::length_error("Checkpoint string is too long: " + value.substr(0, 32));
+    }
+    put(out, static_cast<std::uint16_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+void putSpawn(std::vector<char>& out, std::uint32_t id, const std::string& type, const std::string& name, double x, double y, bool alive) {
+    put(out, Spawn);
+    put(out, id);
+    put(out, x);
+    put(out, y);
+    put(out, static_cast<std::uint8_t>(alive));
+    putString(out, type);
+    putString(out, name);
+}
+
+class Reader {
+public:
+    explicit Reader(std::vector<char> data) : data_(std::move(data)) {}
+
+    bool atEnd() const { return offset_ == data_.size(); }
+
+    template <typename T>
+    bool get(T& value) {
+        if (data_.size() - offset_ < sizeof(T)) return false;
+        std::memcpy(&value, data_.data() + offset_, sizeof(T));
+        offset_ += sizeof(T);
+        return true;
+    }
+
+    bool getString(std::string& value) {
+        std::uint16_t size = 0;
+        if (!get(size) || data_.size() - offset_ < size) return false;
+        value.assign(data_.data() + offset_, size);
+        offset_ += size;
+        return true;
+    }
+
+    bool expect(const char (&tag)[4]) {
+        if (data_.size() - offset_ < 4 || std::memcmp(data_.data() + offset_, tag, 4) != 0) return false;
+        offset_ += 4;
+        return true;
+    }
+
+private:
+    std::vector<char> data_;
+    std::size_t offset_{0};
+};
+
+std::vector<char> readAll(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+struct RestoredNPC {
+    std::string type;
+    std::string name;
+    double x{0.0};
+    double y{0.0};
+    bool alive{false};
+    bool present{false};
+};
+
+struct Spawned {
+    std::uint32_t id;
+    RestoredNPC npc;
+};
+
+bool readSpawnBody(Reader& reader, Spawned& spawned) {
+    std::uint8_t alive = 0;
+    if (!reader.get(spawned.id) || !reader.get(spawned.npc.x) || !reader.get(spawned.npc.y) || !reader.get(alive) ||
+        !reader.getString(spawned.npc.type) || !reader.getString(spawned.npc.name)) {
+        return false;
+    }
+    spawned.npc.alive = alive != 0;
+    spawned.npc.present = true;
+    return true;
+}
+
+void place(std::vector<RestoredNPC>& world, Spawned spawned) {
+    if (world.size() <= spawned.id) {
+        world.resize(spawned.id + 1);
+    }
+    world[spawned.id] = std::move(spawned.npc);
+}
+
+// Файлы вида <prefix>.<generation>.bin
+std::map<std::uint64_t, fs::path> listGenerations(const fs::path& directory, const std::string& prefix) {
+    std::map<std::uint64_t, fs::path> files;
+    if (!fs::exists(directory)) {
+        return files;
+    }
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind(prefix + ".", 0) != 0 || entry.path().extension() != ".bin") continue;
+        const std::string number = name.substr(prefix.size() + 1, name.size() - prefix.size() - 5);
+        if (number.empty() || !std::all_of(number.begin(), number.end(), [](unsigned char c) { return std::isdigit(c); })) continue;
+        files[std::stoull(number)] = entry.path();
+    }
+    return files;
+}
+
+fs::path generationFile(const std::string& directory, const std::string& prefix, std::uint64_t generation) {
+    return fs::path(directory) / (prefix + "." + std::to_string(generation) + ".bin");
+}
+}
+
+CheckpointJournal::CheckpointJournal(const CheckpointConfig& config) : config_(config) {
+    if (config_.snapshotEvery == 0) {
+        throw std::invalid_argument("Snapshot interval must be positive");
+    }
+    fs::create_directories(config_.directory);
+    for (const char* prefix : {"snapshot", "journal"}) {
+        auto files = listGenerations(config_.directory, prefix);
+        if (!files.empty()) {
+            generation_ = std::max(generation_, files.rbegin()->first);
+        }
+    }
+    ++generation_;
+    openJournal(true);
+}
+
+CheckpointJournal::~CheckpointJournal() {
+    flush();
+}
+
+void CheckpointJournal::record(const NPC& npc) {
+    bool inserted = false;
+    const std::uint32_t id = ids_.idOf(npc, inserted);
+    const bool alive = npc.isAlive();
+
+    if (inserted) {
+        if (id % IDENTITY_BLOCK == 0) {
+            identities_.push_back(std::make_shared<IdentityBlock>());
+        }
+        (*identities_.back())[id % IDENTITY_BLOCK] = Identity{npc.getType(), npc.getName()};
+        states_.push_back(State{npc.getX(), npc.getY(), alive});
+        putSpawn(pending_, id, npc.getType(), npc.getName(), npc.getX(), npc.getY(), alive);
+        return;
+    }
+
+    State& state = states_[id];
+    if (state.x != npc.getX() || state.y != npc.getY()) {
+        state.x = npc.getX();
+        state.y = npc.getY();
+        put(pending_, Move);
+        put(pending_, id);
+        put(pending_, state.x);
+        put(pending_, state.y);
+    }
+    if (state.alive && !alive) {
+        state.alive = false;
+        put(pending_, Death);
+        put(pending_, id);
+    }
+}
+
+void CheckpointJournal::commitTick(std::uint64_t tick) {
+    put(pending_, Commit);
+    put(pending_, tick);
+    journal_.write(pending_.data(), static_cast<std::streamsize>(pending_.size()));
+    journal_.flush();
+    pending_.clear();
+
+    if (++ticksSinceSnapshot_ >= config_.snapshotEvery && !snapshotRunning_.load()) {
+        startSnapshot(tick);
+    }
+}
+
+void CheckpointJournal::flush() {
+    if (snapshotThread_.joinable()) {
+        snapshotThread_.join();
+    }
+}
+
+void CheckpointJournal::reset() {
+    flush();
+    ids_.clear();
+    identities_.clear();
+    states_.clear();
+    pending_.clear();
+    put(pending_, Reset);
+}
+
+void CheckpointJournal::openJournal(bool reset) {
+    journal_.close();
+    journal_.open(generationFile(config_.directory, "journal", generation_), std::ios::binary | std::ios::app);
+    if (!journal_) {
+        throw std::runtime_error("Failed to open checkpoint journal in " + config_.directory);
+    }
+    if (reset) {
+        // Новая сессия: идентификаторы прежних файлов больше не действуют
+        put(pending_, Reset);
+    }
+}
+
+void CheckpointJournal::startSnapshot(std::uint64_t tick) {
+    flush();
+    ticksSinceSnapshot_ = 0;
+    ++generation_;
+    openJournal(false);
+
+    snapshotRunning_.store(true);
+    snapshotThread_ = std::thread([this, directory = config_.directory, generation = generation_, tick,
+                                   identities = identities_, states = states_]() mutable {
+        try {
+            writeSnapshot(directory, generation, tick, std::move(identities), std::move(states));
+        } catch (const std::exception&) {
+            // Неудачный снимок не ломает журнал: восстановление возьмёт предыдущий
+        }
+        snapshotRunning_.store(false);
+    });
+}
+
+void CheckpointJournal::writeSnapshot(const std::string& directory, std::uint64_t generation, std::uint64_t tick,
+                                      std::vector<std::shared_ptr<IdentityBlock>> identities, std::vector<State> states) {
+    std::vector<char> buffer;
+    buffer.insert(buffer.end(), std::begin(SNAPSHOT_MAGIC), std::end(SNAPSHOT_MAGIC));
+    put(buffer, tick);
+    put(buffer, static_cast<std::uint64_t>(states.size()));
+    for (std::size_t id = 0; id < states.size(); ++id) {
+        const Identity& identity = (*identities[id / IDENTITY_BLOCK])[id % IDENTITY_BLOCK];
+        putSpawn(buffer, static_cast<std::uint32_t>(id), identity.type, identity.name, states[id].x, states[id].y, states[id].alive);
+    }
+    buffer.insert(buffer.end(), std::begin(SNAPSHOT_END), std::end(SNAPSHOT_END));
+
+    const fs::path target = generationFile(directory, "snapshot", generation);
+    fs::path temporary = target;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        if (!file) {
+            throw std::runtime_error("Failed to write snapshot " + temporary.string());
+        }
+    }
+    fs::rename(temporary, target);
+
+    // Снимок целый: более старые поколения больше не нужны
+    for (const char* prefix : {"snapshot", "journal"}) {
+        for (const auto& [older, path] : listGenerations(directory, prefix)) {
+            if (older < generation) {
+                std::error_code ignored;
+                fs::remove(path, ignored);
+            }
+        }
+    }
+}
+
+std::vector<std::unique_ptr<NPC>> CheckpointJournal::restore(const std::string& directory, const WorldBounds& bounds, std::uint64_t* lastTick) {
+    std::vector<RestoredNPC> world;
+    std::uint64_t tick = 0;
+    std::uint64_t base = 0;
+
+    // Берём последний целый снимок; недописанный пропускаем
+    auto snapshots = listGenerations(directory, "snapshot");
+    for (auto it = snapshots.rbegin(); it != snapshots.rend(); ++it) {
+        Reader reader(readAll(it->second));
+        std::uint64_t count = 0;
+        std::vector<RestoredNPC> loaded;
+        bool valid = reader.expect(SNAPSHOT_MAGIC) && reader.get(tick) && reader.get(count);
+        for (std::uint64_t i = 0; valid && i < count; ++i) {
+            RecordKind kind{};
+            Spawned spawned;
+            valid = reader.get(kind) && kind == Spawn && readSpawnBody(reader, spawned);
+            if (valid) place(loaded, std::move(spawned));
+        }
+        if (valid && reader.expect(SNAPSHOT_END)) {
+            world = std::move(loaded);
+            base = it->first;
+            break;
+        }
+        tick = 0;
+    }
+
+    // Хвост журнала применяется потиково; оборванный последний тик отбрасывается
+    for (const auto& [generation, path] : listGenerations(directory, "journal")) {
+        if (generation < base) continue;
+        Reader reader(readAll(path));
+        std::vector<Spawned> spawns;
+        std::vector<std::pair<std::uint32_t, std::pair<double, double>>> moves;
+        std::vector<std::uint32_t> deaths;
+        bool reset = false;
+
+        while (!reader.atEnd()) {
+            RecordKind kind{};
+            if (!reader.get(kind)) break;
+            bool ok = true;
+            if (kind == Reset) {
+                reset = true;
+                spawns.clear();
+                moves.clear();
+                deaths.clear();
+            } else if (kind == Spawn) {
+                Spawned spawned;
+                ok = readSpawnBody(reader, spawned);
+                if (ok) spawns.push_back(std::move(spawned));
+            } else if (kind == Move) {
+                std::uint32_t id = 0;
+                double x = 0.0, y = 0.0;
+                ok = reader.get(id) && reader.get(x) && reader.get(y);
+                if (ok) moves.push_back({id, {x, y}});
+            } else if (kind == Death) {
+                std::uint32_t id = 0;
+                ok = reader.get(id);
+                if (ok) deaths.push_back(id);
+            } else if (kind == Commit) {
+                ok = reader.get(tick);
+                if (!ok) break;
+                if (reset) {
+                    world.clear();
+                    reset = false;
+                }
+                for (auto& spawned : spawns) place(world, std::move(spawned));
+                for (const auto& [id, position] : moves) {
+                    if (id < world.size()) {
+                        world[id].x = position.first;
+                        world[id].y = position.second;
+                    }
+                }
+                for (auto id : deaths) {
+                    if (id < world.size()) world[id].alive = false;
+                }
+                spawns.clear();
+                moves.clear();
+                deaths.clear();
+            } else {
+                ok = false;
+            }
+            if (!ok) break;
+        }
+    }
+
+    std::vector<std::unique_ptr<NPC>> npcs;
+    for (const auto& restored : world) {
+        if (!restored.present) continue;
+        auto npc = NPCFactory::createNPC(restored.type, restored.name, restored.x, restored.y, bounds);
+        if (!npc) continue;
+        if (!restored.alive) npc->kill();
+        npcs.push_back(std::move(npc));
+    }
+    if (lastTick != nullptr) {
+        *lastTick = tick;
+    }
+    return npcs;
+}
@@ -1,8 +1,8 @@
 #include "desman.hpp"
 #include "battle_visitor.hpp"
 
-Desman::Desman(const std::string& name, double x, double y)
-    : NPC(name, x, y, "Desman", 5.0, 20.0) {}
+Desman::Desman(const std::string& name, double x, double y, const WorldBounds& bounds)
+    : NPC(name, x, y, "Desman", 5.0, 20.0, bounds) {}
 
 void Desman::accept(Visitor& visitor) {
     visitor.visitDesman(*this);
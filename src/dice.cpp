@@ -0,0 +1,29 @@
+#include "dice.hpp"
+#include "npc.hpp"
+#include <string>
+
+namespace {
+std::uint64_t fnv1a(const std::string& text) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+}
+
+std::uint64_t mixSeed(std::uint64_t value) {
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+std::uint64_t npcSeed(std::uint64_t seed, std::uint64_t round, const NPC& npc) {
+    return mixSeed(seed ^ mixSeed(round ^ mixSeed(fnv1a(npc.getName()))));
+}
+
+std::pair<int, int> pairDice(std::uint64_t seed, std::uint64_t round, const NPC& attacker, const NPC& defender) {
+    std::uint64_t h = mixSeed(seed ^ mixSeed(round ^ mixSeed(fnv1a(attacker.getName()) ^ mixSeed(fnv1a(defender.getName())))));
+    return {1 + static_cast<int>(h % 6), 1 + static_cast<int>((h >> 32) % 6)};
+}
@@ -2,35 +2,437 @@
 #include "npc.hpp"
 #include "factory.hpp"
 #include "battle_visitor.hpp"
+#include "dice.hpp"
+#include <array>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <set>
 #include <unordered_set>
 #include <chrono>
+#include <iterator>
+#include <cmath>
+#include <stdexcept>
 
 namespace {
 double randomDelta(double maxStep, std::mt19937& rng) {
     std::uniform_real_distribution<double> dist(-maxStep, maxStep);
     return dist(rng);
 }
+
+int chunksAlong(double extent, double chunkSize) {
+    return std::max(1, static_cast<int>(std::ceil(extent / chunkSize)));
+}
+
+// Собирает убийства задачи, чтобы разослать их наблюдателям в фиксированном порядке
+class KillRecorder : public Observer {
+public:
+    void onKill(const std::string&, const std::string&) override {}
+
+    void onKillEvent(const NPC& killer, const NPC& victim) override {
+        events.emplace_back(&killer, &victim);
+    }
+
+    std::vector<std::pair<const NPC*, const NPC*>> events;
+};
+
+// Пакет боёв столбцами: проверка дистанции идёт одним плотным циклом
+// без ветвлений и виртуальных вызовов, который компилятор векторизует
+struct FightColumns {
+    std::vector<double> ax, ay, bx, by, reach;
+    std::vector<unsigned char> live;
+
+    void resize(std::size_t size) {
+        for (auto* column : {&ax, &ay, &bx, &by, &reach}) {
+            column->resize(size);
+        }
+        live.resize(size);
+    }
+
+    // Без участников задача помечается заранее проигранной по дистанции
+    void set(std::size_t i, const NPC* attacker, const NPC* defender) {
+        if (attacker == nullptr || defender == nullptr) {
+            ax[i] = ay[i] = bx[i] = by[i] = 0.0;
+            reach[i] = -1.0;
+            return;
+        }
+        ax[i] = attacker->getX();
+        ay[i] = attacker->getY();
+        bx[i] = defender->getX();
+        by[i] = defender->getY();
+        reach[i] = attacker->getKillDistance();
+    }
+
+    void markInRange() {
+        const std::size_t size = live.size();
+        for (std::size_t i = 0; i < size; ++i) {
+            const double dx = ax[i] - bx[i];
+            const double dy = ay[i] - by[i];
+            live[i] = static_cast<unsigned char>(reach[i] >= 0.0 && dx * dx + dy * dy <= reach[i] * reach[i]);
+        }
+    }
+};
+
+constexpr std::uint8_t DEAD = 0xff;
+
+std::uint8_t speciesBit(std::uint8_t species) {
+    return static_cast<std::uint8_t>(1u << species);
+}
+
+// preys[s] — маска видов, которых s может убить (правила боя из canKill).
+// Неизвестный вид считается опасным для всех и уязвимым для всех.
+const std::array<std::uint8_t, SPECIES_COUNT>& preyTable() {
+    static const std::array<std::uint8_t, SPECIES_COUNT> table = []() {
+        std::array<std::uint8_t, SPECIES_COUNT> preys{};
+        const std::uint8_t unknown = static_cast<std::uint8_t>(Species::Unknown);
+        for (std::uint8_t attacker = 0; attacker < unknown; ++attacker) {
+            for (std::uint8_t defender = 0; defender < unknown; ++defender) {
+                if (canKill(static_cast<Species>(attacker), static_cast<Species>(defender))) {
+                    preys[attacker] |= speciesBit(defender);
+                }
+            }
+            preys[attacker] |= speciesBit(unknown);
+        }
+        preys[unknown] = static_cast<std::uint8_t>((1u << SPECIES_COUNT) - 1);
+        return preys;
+    }();
+    return table;
+}
+
+// Виды, с которыми у s возможен бой в любую сторону
+std::uint8_t threatMask(std::uint8_t species) {
+    const auto& preys = preyTable();
+    std::uint8_t mask = preys[species];
+    for (std::uint8_t other = 0; other < SPECIES_COUNT; ++other) {
+        if (preys[other] & speciesBit(species)) {
+            mask |= speciesBit(other);
+        }
+    }
+    return mask;
 }
 
-Dungeon::Dungeon() : rng_(std::random_device{}()) {}
+void resolveSeededDuel(NPC& a, NPC& b, std::uint64_t seed, std::vector<std::shared_ptr<Observer>>& observers, std::unordered_set<std::string>& killed) {
+    auto [attackAB, defenseAB] = pairDice(seed, 0, a, b);
+    BattleVisitor visitorAB(b, observers, killed, attackAB, defenseAB);
+    a.accept(visitorAB);
+    if (visitorAB.didKill()) {
+        b.kill();
+    }
+
+    auto [attackBA, defenseBA] = pairDice(seed, 0, b, a);
+    BattleVisitor visitorBA(a, observers, killed, attackBA, defenseBA);
+    b.accept(visitorBA);
+    if (visitorBA.didKill()) {
+        a.kill();
+    }
+}
+}
+
+int Dungeon::chunkReach(double range) const {
+    const int chunksX = chunksAlong(config_.bounds.width, config_.chunkSize);
+    const int chunksY = chunksAlong(config_.bounds.height, config_.chunkSize);
+    const double reachLimit = static_cast<double>(std::max(chunksX, chunksY));
+    return static_cast<int>(std::min(std::ceil(std::max(range, 0.0) / config_.chunkSize), reachLimit));
+}
+
+// При большом радиусе дешевле перебрать пары существующих чанков, чем соседей
+bool Dungeon::scansAllChunks(int reach) const {
+    const auto span = static_cast<std::size_t>(2 * reach + 1);
+    return span * span >= chunks_.size();
+}
+
+// Чанки не дальше reach от itA из полупространства после него:
+// каждая пара чанков посещается один раз
+template <typename ChunkFn>
+void Dungeon::forEachNeighbourChunk(ChunkMap::iterator itA, int reach, bool scanAllChunks, ChunkFn&& fn) {
+    const ChunkCoord origin = itA->first;
+    if (scanAllChunks) {
+        for (auto itB = std::next(itA); itB != chunks_.end(); ++itB) {
+            if (std::abs(itB->first.x - origin.x) <= reach && std::abs(itB->first.y - origin.y) <= reach) {
+                fn(itB->second);
+            }
+        }
+        return;
+    }
+
+    for (int dx = 0; dx <= reach; ++dx) {
+        for (int dy = -reach; dy <= reach; ++dy) {
+            if (dx == 0 && dy <= 0) continue;
+            auto itB = chunks_.find(ChunkCoord{origin.x + dx, origin.y + dy});
+            if (itB != chunks_.end()) {
+                fn(itB->second);
+            }
+        }
+    }
+}
+
+// Пары живых NPC внутри чанка itA и с соседями не дальше reach чанков.
+// Соседи берутся из полупространства, так что каждая пара посещается один раз.
+template <typename PairFn>
+void Dungeon::forEachPairFromChunk(ChunkMap::iterator itA, int reach, bool scanAllChunks, PairFn&& fn) {
+    forEachPairInChunk(itA->second, fn);
+    forEachNeighbourChunk(itA, reach, scanAllChunks, [&](Chunk& neighbour) {
+        forEachPairBetween(itA->second, neighbour, fn);
+    });
+}
+
+template <typename PairFn>
+void Dungeon::forEachPairInChunk(Chunk& chunk, PairFn&& fn) {
+    auto& own = chunk.npcs;
+    for (std::size_t i = 0; i < own.size(); ++i) {
+        if (!own[i]->isAlive()) continue;
+        for (std::size_t j = i + 1; j < own.size(); ++j) {
+            if (!own[j]->isAlive()) continue;
+            fn(*own[i], *own[j]);
+        }
+    }
+}
+
+template <typename PairFn>
+void Dungeon::forEachPairBetween(Chunk& first, Chunk& second, PairFn&& fn) {
+    for (auto& a : first.npcs) {
+        if (!a->isAlive()) continue;
+        for (auto& b : second.npcs) {
+            if (!b->isAlive()) continue;
+            fn(*a, *b);
+        }
+    }
+}
+
+// Перебирает пары живых NPC из одного чанка и из чанков не дальше range.
+// Каждая пара посещается один раз; точную проверку расстояния делает fn.
+template <typename PairFn>
+void Dungeon::forEachCandidatePair(double range, PairFn&& fn) {
+    if (config_.broadphase == Broadphase::SweepAndPrune) {
+        forEachSweepPair(range, [&](const SweepEntry& a, const SweepEntry& b) { fn(*a.npc, *b.npc); });
+        return;
+    }
+    const int reach = chunkReach(range);
+    const bool scanAllChunks = scansAllChunks(reach);
+    for (auto it = chunks_.begin(); it != chunks_.end(); ++it) {
+        forEachPairFromChunk(it, reach, scanAllChunks, fn);
+    }
+}
+
+// Список почти отсортирован: за тик NPC сдвигаются мало, поэтому хватает
+// сортировки вставками. Если сдвигов слишком много (прыжки через всю
+// карту), досортировка передаётся std::sort.
+void Dungeon::refreshSweepLocked() {
+    if (sweepDirty_) {
+        sweep_.clear();
+        for (auto& [coord, chunk] : chunks_) {
+            for (auto& npc : chunk.npcs) {
+                if (npc->isAlive()) {
+                    sweep_.push_back(SweepEntry{npc->getX(), npc->getY(), npc.get(), static_cast<std::uint8_t>(npc->getSpecies())});
+                }
+            }
+        }
+        std::sort(sweep_.begin(), sweep_.end(), [](const SweepEntry& a, const SweepEntry& b) { return a.x < b.x; });
+        sweepDirty_ = false;
+        return;
+    }
+
+    // Умершие лежат в кладбище, так что указатели ещё действительны
+    std::size_t kept = 0;
+    for (auto& entry : sweep_) {
+        if (!entry.npc->isAlive()) continue;
+        entry.x = entry.npc->getX();
+        entry.y = entry.npc->getY();
+        sweep_[kept++] = entry;
+    }
+    sweep_.resize(kept);
+
+    const std::size_t shiftLimit = 16 * sweep_.size();
+    std::size_t shifts = 0;
+    for (std::size_t i = 1; i < sweep_.size(); ++i) {
+        const SweepEntry entry = sweep_[i];
+        std::size_t j = i;
+        while (j > 0 && sweep_[j - 1].x > entry.x) {
+            sweep_[j] = sweep_[j - 1];
+            --j;
+        }
+        sweep_[j] = entry;
+        shifts += i - j;
+        if (shifts > shiftLimit) {
+            std::sort(sweep_.begin(), sweep_.end(), [](const SweepEntry& a, const SweepEntry& b) { return a.x < b.x; });
+            return;
+        }
+    }
+}
+
+// Пары не дальше range друг от друга
+template <typename PairFn>
+void Dungeon::forEachSweepPair(double range, PairFn&& fn) {
+    refreshSweepLocked();
+    const std::size_t size = sweep_.size();
+    const double rangeSquared = range * range;
+    for (std::size_t i = 0; i < size; ++i) {
+        const SweepEntry& a = sweep_[i];
+        for (std::size_t j = i + 1; j < size && sweep_[j].x - a.x <= range; ++j) {
+            const SweepEntry& b = sweep_[j];
+            // Координаты в списке актуальны, так что дальние пары отсекаются
+            // без обращения к самим NPC
+            const double dx = b.x - a.x;
+            const double dy = b.y - a.y;
+            if (dx * dx + dy * dy > rangeSquared) continue;
+            // Погибшие в этом же проходе (battle) больше не участвуют
+            if (!a.npc->isAlive()) break;
+            if (!b.npc->isAlive()) continue;
+            fn(a, b);
+        }
+    }
+}
+
+// Чанки размечаются видами своих NPC и видами в пределах reach.
+// NPC спит, если рядом нет никого, с кем у него возможен бой: такие NPC
+// и такие пары в поиске не участвуют. Разметка пересчитывается каждый тик
+// после движения, так что NPC просыпается, как только опасный сосед
+// оказывается в радиусе; запас на движение за тик не нужен.
+void Dungeon::updateInterestLocked(int reach, bool scanAllChunks) {
+    for (auto& [coord, chunk] : chunks_) {
+        chunk.species.resize(chunk.npcs.size());
+        chunk.present = 0;
+        for (std::size_t i = 0; i < chunk.npcs.size(); ++i) {
+            const NPC& npc = *chunk.npcs[i];
+            chunk.species[i] = npc.isAlive() ? static_cast<std::uint8_t>(npc.getSpecies()) : DEAD;
+            if (chunk.species[i] != DEAD) {
+                chunk.present |= speciesBit(chunk.species[i]);
+            }
+        }
+        chunk.nearby = chunk.present;
+    }
+    for (auto it = chunks_.begin(); it != chunks_.end(); ++it) {
+        forEachNeighbourChunk(it, reach, scanAllChunks, [&](Chunk& neighbour) {
+            it->second.nearby |= neighbour.present;
+            neighbour.nearby |= it->second.present;
+        });
+    }
+
+    std::size_t sleeping = 0;
+    for (const auto& [coord, chunk] : chunks_) {
+        for (auto species : chunk.species) {
+            if (species != DEAD && (threatMask(species) & chunk.nearby) == 0) {
+                ++sleeping;
+            }
+        }
+    }
+    sleeping_.store(sleeping);
+}
+
+// Как forEachCandidatePair, но только пары, где хотя бы один может убить
+// другого; fn получает, кто из двоих охотник: fn(a, b, aHunts, bHunts)
+template <typename PairFn>
+void Dungeon::forEachHostilePair(double range, PairFn&& fn) {
+    if (config_.broadphase == Broadphase::SweepAndPrune) {
+        // Без сетки спящие не выделяются: отсекаются только мирные пары
+        const auto& preys = preyTable();
+        sleeping_.store(0);
+        forEachSweepPair(range, [&](const SweepEntry& a, const SweepEntry& b) {
+            const bool aHunts = (preys[a.species] & speciesBit(b.species)) != 0;
+            const bool bHunts = (preys[b.species] & speciesBit(a.species)) != 0;
+            if (aHunts || bHunts) {
+                fn(*a.npc, *b.npc, aHunts, bHunts);
+            }
+        });
+        return;
+    }
+
+    const int reach = chunkReach(range);
+    const bool scanAllChunks = scansAllChunks(reach);
+    updateInterestLocked(reach, scanAllChunks);
+
+    const auto& preys = preyTable();
+    std::array<std::uint8_t, SPECIES_COUNT> threats{};
+    for (std::uint8_t species = 0; species < SPECIES_COUNT; ++species) {
+        threats[species] = threatMask(species);
+    }
+    // Виды с возможным боем хотя бы с одним видом из mask
+    auto threatenedBy = [&](std::uint8_t mask) {
+        std::uint8_t result = 0;
+        for (std::uint8_t species = 0; species < SPECIES_COUNT; ++species) {
+            if (mask & speciesBit(species)) result |= threats[species];
+        }
+        return result;
+    };
+    auto visit = [&](NPC& a, std::uint8_t sa, NPC& b, std::uint8_t sb) {
+        if (sb == DEAD) return;
+        const bool aHunts = (preys[sa] & speciesBit(sb)) != 0;
+        const bool bHunts = (preys[sb] & speciesBit(sa)) != 0;
+        if (aHunts || bHunts) {
+            fn(a, b, aHunts, bHunts);
+        }
+    };
+
+    for (auto it = chunks_.begin(); it != chunks_.end(); ++it) {
+        Chunk& own = it->second;
+        // Бодрствующие виды чанка: те, у кого есть возможный противник рядом
+        const std::uint8_t awake = own.present & threatenedBy(own.nearby);
+        if (awake == 0) continue;
+        auto isAwake = [&](std::uint8_t species) { return species != DEAD && (awake & speciesBit(species)) != 0; };
+
+        for (std::size_t i = 0; i < own.npcs.size(); ++i) {
+            if (!isAwake(own.species[i])) continue;
+            for (std::size_t j = i + 1; j < own.npcs.size(); ++j) {
+                visit(*own.npcs[i], own.species[i], *own.npcs[j], own.species[j]);
+            }
+        }
+        const std::uint8_t targets = threatenedBy(awake);
+        forEachNeighbourChunk(it, reach, scanAllChunks, [&](Chunk& neighbour) {
+            if ((neighbour.present & targets) == 0) return;
+            for (std::size_t i = 0; i < own.npcs.size(); ++i) {
+                if (!isAwake(own.species[i])) continue;
+                for (std::size_t j = 0; j < neighbour.npcs.size(); ++j) {
+                    visit(*own.npcs[i], own.species[i], *neighbour.npcs[j], neighbour.species[j]);
+                }
+            }
+        });
+    }
+}
+
+template <typename NpcFn>
+void Dungeon::forEachNPC(NpcFn&& fn) const {
+    for (const auto& [coord, chunk] : chunks_) {
+        for (const auto& npc : chunk.npcs) {
+            fn(*npc);
+        }
+    }
+    for (const auto& npc : graveyard_) {
+        fn(*npc);
+    }
+    if (lazy_) {
+        lazy_->forEachReady(fn);
+    }
+}
+
+Dungeon::Dungeon() : Dungeon(DungeonConfig{}) {}
+
+Dungeon::Dungeon(const DungeonConfig& config) : config_(config), pacer_(config.pacing), rng_(std::random_device{}()) {
+    if (config_.bounds.width <= 0.0 || config_.bounds.height <= 0.0) {
+        throw std::invalid_argument("World size must be positive");
+    }
+    if (config_.chunkSize <= 0.0) {
+        throw std::invalid_argument("Chunk size must be positive");
+    }
+}
 
 void Dungeon::addNPC(std::unique_ptr<NPC> npc) {
-    std::lock_guard<std::shared_mutex> lock(npcsMutex_);
-    npcs_.push_back(std::move(npc));
+    LockSiteScope site(LockSite::AddNPC);
+    std::lock_guard<ProfiledSharedMutex> lock(npcsMutex_);
+    insertLocked(std::move(npc));
 }
 
 void Dungeon::spawnRandomNPCs(std::size_t count) {
     std::vector<std::string> types = {"Bear", "Heron", "Desman"};
     std::uniform_int_distribution<int> typeDist(0, static_cast<int>(types.size()) - 1);
-    std::uniform_real_distribution<double> posDist(NPC::MAP_MIN, NPC::MAP_MAX);
+    std::uniform_real_distribution<double> xDist(NPC::MAP_MIN, config_.bounds.width);
+    std::uniform_real_distribution<double> yDist(NPC::MAP_MIN, config_.bounds.height);
 
     for (std::size_t i = 0; i < count; ++i) {
         std::string type = types[typeDist(rng_)];
         std::string name = type + std::to_string(i + 1);
-        auto npc = NPCFactory::createNPC(type, name, posDist(rng_), posDist(rng_));
+        double x = xDist(rng_);
+        double y = yDist(rng_);
+        auto npc = NPCFactory::createNPC(type, name, x, y, config_.bounds);
         if (npc) {
             addNPC(std::move(npc));
         }
@@ -38,61 +440,140 @@ void Dungeon::spawnRandomNPCs(std::size_t count) {
 }
 
 void Dungeon::saveToFile(const std::string& filename) const {
-    std::shared_lock<std::shared_mutex> lock(npcsMutex_);
+    LockSiteScope site(LockSite::SaveToFile);
+    requestLazy(nullptr);
+    std::shared_lock<ProfiledSharedMutex> lock(npcsMutex_);
     std::ofstream file(filename);
-    for (const auto& npc : npcs_) {
-        file << npc->getType() << " " << npc->getName() << " " << npc->getX() << " " << npc->getY() << std::endl;
-    }
+    forEachNPC([&](const NPC& npc) {
+        file << npc.getType() << " " << npc.getName() << " " << npc.getX() << " " << npc.getY() << std::endl;
+    });
 }
 
 std::size_t Dungeon::loadFromFile(const std::string& filename) {
-    auto loaded = NPCFactory::loadFromFile(filename);
-    std::lock_guard<std::shared_mutex> lock(npcsMutex_);
-    npcs_ = std::move(loaded);
-    return npcs_.size();
+    auto loaded = NPCFactory::loadFromFile(filename, config_.bounds);
+    std::lock_guard<ProfiledSharedMutex> lock(npcsMutex_);
+    std::size_t count = loaded.size();
+    replaceAllLocked(std::move(loaded));
+    return count;
 }
 
-void Dungeon::print() const {
-    std::shared_lock<std::shared_mutex> lock(npcsMutex_);
-    for (const auto& npc : npcs_) {
-        std::cout << npc->getType() << " " << npc->getName() << " at (" << npc->getX() << ", " << npc->getY() << ")" << std::endl;
-    }
+void Dungeon::saveRegionSnapshot(const std::string& filename) const {
+    requestLazy(nullptr);
+    std::shared_lock<ProfiledSharedMutex> lock(npcsMutex_);
+    std::vector<const NPC*> npcs;
+    forEachNPC([&](const NPC& npc) { npcs.push_back(&npc); });
+    RegionSnapshot::write(filename, npcs, config_.snapshotRegionSize);
 }
 
-void Dungeon::printMap() const {
-    std::shared_lock<std::shared_mutex> dataLock(npcsMutex_);
-    std::lock_guard<std::mutex> outLock(coutMutex_);
-
-    constexpr int GRID = 50;
-    constexpr double cellSize = (NPC::MAP_MAX - NPC::MAP_MIN) / GRID;
+std::size_t Dungeon::loadLazy(const std::string& filename) {
+    auto snapshot = std::make_shared<const RegionSnapshot>(filename);
+    const std::size_t count = snapshot->npcCount();
+    std::lock_guard<ProfiledSharedMutex> lock(npcsMutex_);
+    replaceAllLocked({});
+    // Дальность боя известна из заголовка: поиск пар не зависит от того, что уже загружено
+    maxKillDistance_ = snapshot->maxKillDistance();
+    lazy_ = std::make_shared<LazyRegions>(std::move(snapshot), config_.bounds);
+    lazyPending_ = true;
+    retireLazyLocked();
+    return count;
+}
 
-    std::vector<std::vector<char>> grid(GRID, std::vector<char>(GRID, ' '));
+std::size_t Dungeon::dormantRegions() const {
+    std::shared_lock<ProfiledSharedMutex> lock(npcsMutex_);
+    return lazy_ ? lazy_->dormant() : 0;
+}
 
-    for (const auto& npc : npcs_) {
-        if (!npc->isAlive()) continue;
-        int gx = static_cast<int>((npc->getX() - NPC::MAP_MIN) / cellSize);
-        int gy = static_cast<int>((npc->getY() - NPC::MAP_MIN) / cellSize);
-        gx = std::clamp(gx, 0, GRID - 1);
-        gy = std::clamp(gy, 0, GRID - 1);
+void Dungeon::setJournal(std::shared_ptr<CheckpointJournal> journal) {
+    std::lock_guard<ProfiledSharedMutex> lock(npcsMutex_);
+    journal_ = std::move(journal);
+    journaledGraveyard_ = 0;
+}
 
-        char mark = npc->getType().empty() ? '?' : static_cast<char>(std::toupper(npc->getType().front()));
-        if (grid[gy][gx] != ' ' && grid[gy][gx] != mark) {
-            grid[gy][gx] = '*';
-        } else {
-            grid[gy][gx] = mark;
+void Dungeon::recordCheckpoint() {
+    std::lock_guard<ProfiledMutex> journalLock(journalMutex_);
+    std::shared_ptr<CheckpointJournal> journal;
+    {
+        std::lock_guard<ProfiledSharedMutex> lock(npcsMutex_);
+        if (!journal_) {
+            return;
         }
+        journal = journal_;
+        materializeAllLocked();
+        recordCheckpointLocked();
     }
+    // Запись на диск — уже без блокировки мира
+    journal->commitTick(tick_++);
+}
 
-    std::cout << "=== Map 50x50 ===" << std::endl;
-    for (int y = 0; y < GRID; ++y) {
-        for (int x = 0; x < GRID; ++x) {
-            char mark = grid[y][x];
-            if (mark == ' ') mark = ' ';
-            std::cout << '[' << mark << ']';
+std::size_t Dungeon::restoreCheckpoint(const std::string& directory) {
+    std::uint64_t lastTick = 0;
+    auto restored = CheckpointJournal::restore(directory, config_.bounds, &lastTick);
+    std::lock_guard<ProfiledSharedMutex> lock(npcsMutex_);
+    std::size_t count = restored.size();
+    replaceAllLocked(std::move(restored));
+    tick_ = lastTick + 1;
+    return count;
+}
+
+void Dungeon::setTrajectoryRecorder(std::shared_ptr<TrajectoryRecorder> recorder) {
+    std::lock_guard<ProfiledSharedMutex> lock(npcsMutex_);
+    trajectory_ = std::move(recorder);
+    recordedGraveyard_ = 0;
+}
+
+void Dungeon::print() const {
+    requestLazy(nullptr);
+    std::shared_lock<ProfiledSharedMutex> lock(npcsMutex_);
+    forEachNPC([](const NPC& npc) {
+        std::cout << npc.getType() << " " << npc.getName() << " at (" << npc.getX() << ", " << npc.getY() << ")" << std::endl;
+    });
+}
+
+void Dungeon::printMap() const {
+    LockSiteScope site(LockSite::PrintMap);
+    std::lock_guard<ProfiledMutex> outLock(coutMutex_);
+    const std::uint64_t version = worldVersion_.load();
+    if (renderer_ && version == renderedVersion_) {
+        return;
+    }
+    if (!renderer_) {
+        renderer_ = std::make_unique<MapRenderer>();
+    }
+    const Viewport area = renderer_->visibleArea(config_.bounds);
+    requestLazy(&area);
+
+    {
+        std::shared_lock<ProfiledSharedMutex> dataLock(npcsMutex_);
+        renderer_->beginFrame(config_.bounds);
+
+        // Обходятся только чанки, попадающие в видимую область
+        const ChunkCoord low = chunkOf(area.x, area.y);
+        const ChunkCoord high = chunkOf(area.x + area.width, area.y + area.height);
+        for (int cx = low.x; cx <= high.x; ++cx) {
+            for (auto it = chunks_.lower_bound(ChunkCoord{cx, low.y}); it != chunks_.end() && it->first.x == cx && it->first.y <= high.y; ++it) {
+                for (const auto& npc : it->second.npcs) {
+                    if (!npc->isAlive()) continue;
+                    char mark = npc->getType().empty() ? '?' : static_cast<char>(std::toupper(npc->getType().front()));
+                    renderer_->plot(npc->getX(), npc->getY(), mark);
+                }
+            }
+        }
+        if (lazy_) {
+            lazy_->forEachReady([&](const NPC& npc) {
+                if (!npc.isAlive()) return;
+                renderer_->plot(npc.getX(), npc.getY(), npc.getType().empty() ? '?' : static_cast<char>(std::toupper(npc.getType().front())));
+            });
         }
-        std::cout << '\n';
     }
-    std::cout << "================" << std::endl;
+
+    renderer_->present();
+    renderedVersion_ = version;
+}
+
+void Dungeon::setRenderConfig(const RenderConfig& config) {
+    std::lock_guard<ProfiledMutex> outLock(coutMutex_);
+    renderer_ = std::make_unique<MapRenderer>(config);
+    renderedVersion_ = UINT64_MAX;
 }
 
 void Dungeon::battle(double range, std::vector<std::shared_ptr<Observer>>& observers) {
@@ -100,22 +581,87 @@ void Dungeon::battle(double range, std::vector<std::shared_ptr<Observer>>& obser
     std::mt19937 rng(std::random_device{}());
     std::uniform_int_distribution<int> dice(1, 6);
 
-    std::lock_guard<std::shared_mutex> lock(npcsMutex_);
-    for (size_t i = 0; i < npcs_.size(); ++i) {
-        if (!npcs_[i]->isAlive()) continue;
-        for (size_t j = i + 1; j < npcs_.size(); ++j) {
-            if (!npcs_[j]->isAlive()) continue;
-            if (npcs_[i]->distanceTo(*npcs_[j]) <= range) {
-                BattleVisitor visitorAB(*npcs_[j], observers, killed, dice(rng), dice(rng));
-                npcs_[i]->accept(visitorAB);
-                if (visitorAB.didKill()) {
-                    npcs_[j]->kill();
+    std::lock_guard<ProfiledSharedMutex> lock(npcsMutex_);
+    materializeAllLocked();
+    worldVersion_.fetch_add(1);
+    forEachCandidatePair(range, [&](NPC& a, NPC& b) {
+        if (a.distanceTo(b) > range) return;
+
+        BattleVisitor visitorAB(b, observers, killed, dice(rng), dice(rng));
+        a.accept(visitorAB);
+        if (visitorAB.didKill()) {
+            b.kill();
+        }
+
+        BattleVisitor visitorBA(a, observers, killed, dice(rng), dice(rng));
+        b.accept(visitorBA);
+        if (visitorBA.didKill()) {
+            a.kill();
+        }
+    });
+}
+
+void Dungeon::battle(double range, std::vector<std::shared_ptr<Observer>>& observers, std::size_t threads, std::uint64_t seed) {
+    std::lock_guard<ProfiledSharedMutex> lock(npcsMutex_);
+    materializeAllLocked();
+    worldVersion_.fetch_add(1);
+    const int reach = std::max(chunkReach(range), 1);
+
+    // Суперклетки со стороной reach чанков: бои из клетки не выходят за соседние
+    // клетки, поэтому клетки одного из 9 цветов (шаг 3) независимы при любом радиусе
+    std::map<ChunkCoord, std::vector<ChunkMap::iterator>> cells;
+    for (auto it = chunks_.begin(); it != chunks_.end(); ++it) {
+        cells[ChunkCoord{it->first.x / reach, it->first.y / reach}].push_back(it);
+    }
+    std::array<std::vector<std::pair<ChunkCoord, const std::vector<ChunkMap::iterator>*>>, 9> colours;
+    for (const auto& [cell, members] : cells) {
+        colours[static_cast<std::size_t>((cell.x % 3) * 3 + cell.y % 3)].emplace_back(cell, &members);
+    }
+
+    threads = std::max<std::size_t>(threads, 1);
+    if (!battlePool_ || battlePool_->size() != threads) {
+        battlePool_ = std::make_unique<ThreadPool>(threads);
+    }
+
+    for (const auto& colour : colours) {
+        std::vector<std::shared_ptr<KillRecorder>> recorders(colour.size());
+        battlePool_->parallelFor(colour.size(), [&](std::size_t i) {
+            auto recorder = std::make_shared<KillRecorder>();
+            std::vector<std::shared_ptr<Observer>> taskObservers = {recorder};
+            std::unordered_set<std::string> killed;
+            auto duel = [&](NPC& a, NPC& b) {
+                if (a.distanceTo(b) <= range) {
+                    resolveSeededDuel(a, b, seed, taskObservers, killed);
+                }
+            };
+
+            // Соседи — только существующие чанки 3x3 клеток, без поиска по смещениям
+            const auto& [cell, members] = colour[i];
+            std::vector<ChunkMap::iterator> block;
+            for (int dx = -1; dx <= 1; ++dx) {
+                for (int dy = -1; dy <= 1; ++dy) {
+                    auto found = cells.find(ChunkCoord{cell.x + dx, cell.y + dy});
+                    if (found != cells.end()) {
+                        block.insert(block.end(), found->second.begin(), found->second.end());
+                    }
                 }
+            }
+            for (auto itA : *members) {
+                forEachPairInChunk(itA->second, duel);
+                // Пара чанков достаётся меньшему по порядку карты, как в forEachNeighbourChunk
+                for (auto itB : block) {
+                    if (itA->first < itB->first && std::abs(itB->first.x - itA->first.x) <= reach && std::abs(itB->first.y - itA->first.y) <= reach) {
+                        forEachPairBetween(itA->second, itB->second, duel);
+                    }
+                }
+            }
+            recorders[i] = std::move(recorder);
+        });
 
-                BattleVisitor visitorBA(*npcs_[i], observers, killed, dice(rng), dice(rng));
-                npcs_[j]->accept(visitorBA);
-                if (visitorBA.didKill()) {
-                    npcs_[i]->kill();
+        for (const auto& recorder : recorders) {
+            for (const auto& [killer, victim] : recorder->events) {
+                for (auto& obs : observers) {
+                    obs->onKillEvent(*killer, *victim);
                 }
             }
         }
@@ -135,62 +681,209 @@ void Dungeon::notifyBattleThread() {
 }
 
 std::vector<std::string> Dungeon::survivors() const {
+    LockSiteScope site(LockSite::Survivors);
     std::vector<std::string> alive;
-    std::shared_lock<std::shared_mutex> lock(npcsMutex_);
-    for (const auto& npc : npcs_) {
-        if (npc->isAlive()) {
-            alive.push_back(npc->getName());
+    requestLazy(nullptr);
+    std::shared_lock<ProfiledSharedMutex> lock(npcsMutex_);
+    forEachNPC([&](const NPC& npc) {
+        if (npc.isAlive()) {
+            alive.push_back(npc.getName());
         }
-    }
+    });
     return alive;
 }
 
+std::uint64_t Dungeon::tick() const {
+    return tick_.load();
+}
+
+std::size_t Dungeon::populatedChunks() const {
+    requestLazy(nullptr);
+    std::shared_lock<ProfiledSharedMutex> lock(npcsMutex_);
+    std::set<ChunkCoord> populated;
+    for (const auto& [coord, chunk] : chunks_) {
+        if (std::any_of(chunk.npcs.begin(), chunk.npcs.end(), [](const auto& npc) { return npc->isAlive(); })) {
+            populated.insert(coord);
+        }
+    }
+    if (lazy_) {
+        lazy_->forEachReady([&](const NPC& npc) {
+            if (npc.isAlive()) {
+                populated.insert(chunkOf(npc.getX(), npc.getY()));
+            }
+        });
+    }
+    return populated.size();
+}
+
+void Dungeon::moveAll(std::mt19937& rng) {
+    std::lock_guard<ProfiledSharedMutex> lock(npcsMutex_);
+    materializeAllLocked();
+    moveAllLocked(rng);
+}
+
+void Dungeon::moveAll(std::uint64_t seed, std::uint64_t round) {
+    std::lock_guard<ProfiledSharedMutex> lock(npcsMutex_);
+    materializeAllLocked();
+    moveEachLocked([&](NPC& npc) {
+        std::mt19937 rng(static_cast<std::mt19937::result_type>(npcSeed(seed, round, npc)));
+        randomStep(npc, rng);
+    }, nullptr);
+}
+
+std::vector<std::unique_ptr<NPC>> Dungeon::extractIf(const std::function<bool(const NPC&)>& predicate) {
+    std::vector<std::unique_ptr<NPC>> extracted;
+    std::lock_guard<ProfiledSharedMutex> lock(npcsMutex_);
+    materializeAllLocked();
+    for (auto it = chunks_.begin(); it != chunks_.end();) {
+        auto& npcs = it->second.npcs;
+        auto middle = std::stable_partition(npcs.begin(), npcs.end(), [&](const auto& npc) {
+            return !npc->isAlive() || !predicate(*npc);
+        });
+        std::move(middle, npcs.end(), std::back_inserter(extracted));
+        npcs.erase(middle, npcs.end());
+        it = npcs.empty() ? chunks_.erase(it) : std::next(it);
+    }
+    sweepDirty_ = true;
+    worldVersion_.fetch_add(1);
+    return extracted;
+}
+
+void Dungeon::forEachAlive(const std::function<void(NPC&)>& fn) {
+    std::lock_guard<ProfiledSharedMutex> lock(npcsMutex_);
+    materializeAllLocked();
+    for (auto& [coord, chunk] : chunks_) {
+        for (auto& npc : chunk.npcs) {
+            if (npc->isAlive()) {
+                fn(*npc);
+            }
+        }
+    }
+}
+
+void Dungeon::forEachPairInRange(double range, const std::function<void(NPC&, NPC&)>& fn) {
+    std::lock_guard<ProfiledSharedMutex> lock(npcsMutex_);
+    materializeAllLocked();
+    forEachCandidatePair(range, [&](NPC& a, NPC& b) {
+        if (a.distanceTo(b) <= range) {
+            fn(a, b);
+        }
+    });
+}
+
+double Dungeon::maxKillDistance() const {
+    std::shared_lock<ProfiledSharedMutex> lock(npcsMutex_);
+    return maxKillDistance_;
+}
+
 void Dungeon::movementLoop(std::atomic<bool>& stopFlag) {
-    using namespace std::chrono_literals;
     std::mt19937 localRng(std::random_device{}());
 
     while (!stopFlag.load()) {
+        const auto tickStart = std::chrono::steady_clock::now();
+        movementTick(localRng);
+        queueCv_.notify_all();
+        const auto work = std::chrono::steady_clock::now() - tickStart;
+        std::size_t depth = 0;
         {
-            std::unique_lock<std::shared_mutex> lock(npcsMutex_);
-            for (auto& npc : npcs_) {
-                if (!npc->isAlive()) {
-                    continue;
+            // Опрос очереди между тиками — отдельное место, а не «прочее»
+            LockSiteScope site(LockSite::Pacing);
+            depth = fightQueueDepth();
+        }
+        std::this_thread::sleep_for(pacer_.nextInterval(work, depth));
+    }
+    queueCv_.notify_all();
+}
+
+void Dungeon::movementTick(std::mt19937& rng) {
+    LockSiteScope site(LockSite::MovementLoop);
+    const auto tickStart = std::chrono::steady_clock::now();
+    const std::size_t depth = fightQueueDepth();
+    // Пока бой отстаёт, поиск соседей откладывается: близкие пары никуда
+    // не денутся и найдутся на следующем тике
+    const bool scan = pacer_.shouldScan(depth);
+    const std::size_t room = pacer_.config().queueCapacity - std::min(depth, pacer_.config().queueCapacity);
+    std::size_t dropped = 0;
+
+    std::vector<FightTask> batch;
+    std::unique_lock<ProfiledMutex> journalLock(journalMutex_);
+    prepareLazy();
+    std::shared_ptr<CheckpointJournal> journal;
+    std::shared_ptr<TrajectoryRecorder> trajectory;
+    {
+        std::unique_lock<ProfiledSharedMutex> lock(npcsMutex_);
+        if (journal_ && journal_->snapshotDue()) {
+            // Снимок журнала удаляет прежние поколения: в нём должен быть весь мир
+            materializeAllLocked();
+        }
+        // Кадр траектории снимается в том же проходе, что и движение:
+        // второй обход миллиона NPC стоил бы дороже самой записи
+        TrajectoryRecorder* frame = trajectory_ && trajectory_->wantsTick(tick_.load()) ? trajectory_.get() : nullptr;
+        if (frame) {
+            trajectory = trajectory_;
+            frame->beginFrame(tick_.load());
+        }
+        moveAllLocked(rng, frame);
+        // После движения: бои с соседней областью нужны уже на этом тике
+        materializeTouchedLocked();
+        if (journal_) {
+            journal = journal_;
+            recordCheckpointLocked();
+        }
+        if (frame) {
+            finishTrajectoryFrameLocked();
+        }
+
+        auto offer = [&](NPC& attacker, NPC& defender) {
+            if (batch.size() < room) {
+                batch.push_back(FightTask{&attacker, &defender, tickStart});
+            } else {
+                ++dropped;
+            }
+        };
+        if (scan) {
+            forEachHostilePair(maxKillDistance_, [&](NPC& a, NPC& b, bool aHunts, bool bHunts) {
+                double distance = a.distanceTo(b);
+                if (aHunts && distance <= a.getKillDistance()) {
+                    offer(a, b);
                 }
-                double dx = randomDelta(npc->getMoveDistance(), localRng);
-                double dy = randomDelta(npc->getMoveDistance(), localRng);
-                npc->moveBy(dx, dy);
-            }
-
-            for (size_t i = 0; i < npcs_.size(); ++i) {
-                if (!npcs_[i]->isAlive()) continue;
-                for (size_t j = i + 1; j < npcs_.size(); ++j) {
-                    if (!npcs_[j]->isAlive()) continue;
-                    double distance = npcs_[i]->distanceTo(*npcs_[j]);
-                    if (distance <= npcs_[i]->getKillDistance()) {
-                        enqueueFight(npcs_[i].get(), npcs_[j].get());
-                    }
-                    if (distance <= npcs_[j]->getKillDistance()) {
-                        enqueueFight(npcs_[j].get(), npcs_[i].get());
-                    }
+                if (bHunts && distance <= b.getKillDistance()) {
+                    offer(b, a);
                 }
-            }
+            });
         }
+    }
+    enqueueFights(batch);
+    // Если писатель траекторий отстал, ждёт только поток движения, мир свободен
+    if (trajectory) {
+        trajectory->publish();
+    }
+    if (dropped > 0) {
+        pacer_.recordDropped(dropped);
+    }
 
-        queueCv_.notify_all();
-        std::this_thread::sleep_for(200ms);
+    const std::uint64_t finishedTick = tick_++;
+    if (journal) {
+        journal->commitTick(finishedTick);
     }
-    queueCv_.notify_all();
 }
 
 void Dungeon::battleLoop(std::atomic<bool>& stopFlag, std::vector<std::shared_ptr<Observer>> observers) {
+    LockSiteScope site(LockSite::BattleLoop);
     std::unordered_set<std::string> killedNames;
     std::mt19937 rng(std::random_device{}());
     std::uniform_int_distribution<int> dice(1, 6);
+    const std::size_t batchSize = std::max<std::size_t>(config_.fightBatch, 1);
+    std::vector<FightTask> tasks;
+    FightColumns columns;
+    std::vector<std::size_t> ready;
+    std::vector<int> rolls;
+    tasks.reserve(batchSize);
 
     while (true) {
-        FightTask task{};
+        tasks.clear();
         {
-            std::unique_lock<std::mutex> lock(queueMutex_);
+            std::unique_lock<ProfiledMutex> lock(queueMutex_);
             queueCv_.wait(lock, [&]() { return !fights_.empty() || stopFlag.load(); });
             if (fights_.empty()) {
                 if (stopFlag.load()) {
@@ -198,39 +891,109 @@ void Dungeon::battleLoop(std::atomic<bool>& stopFlag, std::vector<std::shared_pt
                 }
                 continue;
             }
-            task = fights_.front();
-            fights_.pop();
+            while (!fights_.empty() && tasks.size() < batchSize) {
+                tasks.push_back(fights_.front());
+                fights_.pop();
+            }
         }
+        // Самый старый бой пакета: его ожидание и есть задержка пакета
+        pacer_.recordBattleLatency(std::chrono::steady_clock::now() - tasks.front().enqueuedAt);
 
-        std::shared_lock<std::shared_mutex> dataLock(npcsMutex_);
-        if (task.attacker == nullptr || task.defender == nullptr) {
-            continue;
+        std::shared_lock<ProfiledSharedMutex> dataLock(npcsMutex_);
+        columns.resize(tasks.size());
+        for (std::size_t i = 0; i < tasks.size(); ++i) {
+            const FightTask& task = tasks[i];
+            const bool valid = task.attacker != nullptr && task.defender != nullptr && task.attacker->isAlive() && task.defender->isAlive();
+            columns.set(i, valid ? task.attacker : nullptr, valid ? task.defender : nullptr);
         }
-
-        if (!task.attacker->isAlive() || !task.defender->isAlive()) {
-            continue;
+        columns.markInRange();
+        ready.clear();
+        for (std::size_t i = 0; i < tasks.size(); ++i) {
+            if (columns.live[i]) {
+                ready.push_back(i);
+            }
         }
 
-        if (task.attacker->distanceTo(*task.defender) > task.attacker->getKillDistance()) {
-            continue;
+        // Кости бросаются только для актуальных боёв, одним проходом
+        rolls.resize(ready.size() * 2);
+        for (auto& roll : rolls) {
+            roll = dice(rng);
         }
 
-        BattleVisitor visitor(*task.defender, observers, killedNames, dice(rng), dice(rng));
-        task.attacker->accept(visitor);
-        if (visitor.didKill()) {
-            task.defender->kill();
+        bool anyKill = false;
+        for (std::size_t k = 0; k < ready.size(); ++k) {
+            FightTask& task = tasks[ready[k]];
+            // Участник мог погибнуть в одном из предыдущих боёв пакета
+            if (!task.attacker->isAlive() || !task.defender->isAlive()) continue;
+
+            BattleVisitor visitor(*task.defender, observers, killedNames, rolls[2 * k], rolls[2 * k + 1]);
+            task.attacker->accept(visitor);
+            if (visitor.didKill()) {
+                task.defender->kill();
+                anyKill = true;
+            }
+        }
+        if (anyKill) {
+            worldVersion_.fetch_add(1);
         }
     }
 }
 
-void Dungeon::enqueueFight(NPC* attacker, NPC* defender) {
-    std::lock_guard<std::mutex> lock(queueMutex_);
-    fights_.push(FightTask{attacker, defender});
+void Dungeon::enqueueFights(const std::vector<FightTask>& batch) {
+    if (batch.empty()) {
+        return;
+    }
+    std::size_t dropped = 0;
+    {
+        std::lock_guard<ProfiledMutex> lock(queueMutex_);
+        for (const auto& task : batch) {
+            if (fights_.size() < pacer_.config().queueCapacity) {
+                fights_.push(task);
+            } else {
+                ++dropped;
+            }
+        }
+    }
+    if (dropped > 0) {
+        pacer_.recordDropped(dropped);
+    }
     queueCv_.notify_one();
 }
 
+std::size_t Dungeon::fightQueueDepth() const {
+    std::lock_guard<ProfiledMutex> lock(queueMutex_);
+    return fights_.size();
+}
+
+std::size_t Dungeon::sleepingNPCs() const {
+    return sleeping_.load();
+}
+
+PacingStats Dungeon::pacingStats() const {
+    return pacer_.stats();
+}
+
+void Dungeon::enableLockProfiling(bool enabled) {
+    npcsMutex_.profile().setEnabled(enabled);
+    queueMutex_.profile().setEnabled(enabled);
+    coutMutex_.profile().setEnabled(enabled);
+}
+
+std::vector<LockSiteStats> Dungeon::lockProfile() const {
+    std::vector<LockSiteStats> stats;
+    for (const LockProfile* profile : {&npcsMutex_.profile(), &queueMutex_.profile(), &coutMutex_.profile()}) {
+        auto rows = profile->snapshot();
+        stats.insert(stats.end(), rows.begin(), rows.end());
+    }
+    return stats;
+}
+
+void Dungeon::dumpLockProfile(std::ostream& out) const {
+    dumpLockStats(out, lockProfile());
+}
+
 bool Dungeon::tryPopFight(FightTask& task) {
-    std::lock_guard<std::mutex> lock(queueMutex_);
+    std::lock_guard<ProfiledMutex> lock(queueMutex_);
     if (fights_.empty()) {
         return false;
     }
@@ -243,4 +1006,215 @@ void Dungeon::randomStep(NPC& npc, std::mt19937& rng) {
     double dx = randomDelta(npc.getMoveDistance(), rng);
     double dy = randomDelta(npc.getMoveDistance(), rng);
     npc.moveBy(dx, dy);
-}
\ No newline at end of file
+}
+
+Dungeon::ChunkCoord Dungeon::chunkOf(double x, double y) const {
+    const int maxX = chunksAlong(config_.bounds.width, config_.chunkSize) - 1;
+    const int maxY = chunksAlong(config_.bounds.height, config_.chunkSize) - 1;
+    int cx = static_cast<int>((x - NPC::MAP_MIN) / config_.chunkSize);
+    int cy = static_cast<int>((y - NPC::MAP_MIN) / config_.chunkSize);
+    return ChunkCoord{std::clamp(cx, 0, maxX), std::clamp(cy, 0, maxY)};
+}
+
+void Dungeon::insertLocked(std::unique_ptr<NPC> npc) {
+    if (!npc) {
+        return;
+    }
+    npc->setBounds(config_.bounds);
+    maxKillDistance_ = std::max(maxKillDistance_, npc->getKillDistance());
+    if (!npc->isAlive()) {
+        graveyard_.push_back(std::move(npc));
+        worldVersion_.fetch_add(1);
+        return;
+    }
+    chunks_[chunkOf(npc->getX(), npc->getY())].npcs.push_back(std::move(npc));
+    sweepDirty_ = true;
+    worldVersion_.fetch_add(1);
+}
+
+void Dungeon::moveAllLocked(std::mt19937& rng, TrajectoryRecorder* frame) {
+    moveEachLocked([&](NPC& npc) { randomStep(npc, rng); }, frame);
+}
+
+template <typename StepFn>
+void Dungeon::moveEachLocked(StepFn&& step, TrajectoryRecorder* frame) {
+    std::vector<std::unique_ptr<NPC>> migrants;
+    worldVersion_.fetch_add(1);
+
+    for (auto it = chunks_.begin(); it != chunks_.end();) {
+        auto& npcs = it->second.npcs;
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < npcs.size(); ++i) {
+            if (!npcs[i]->isAlive()) {
+                graveyard_.push_back(std::move(npcs[i]));
+                continue;
+            }
+            step(*npcs[i]);
+            if (frame) {
+                frame->record(*npcs[i]);
+            }
+            if (chunkOf(npcs[i]->getX(), npcs[i]->getY()) != it->first) {
+                migrants.push_back(std::move(npcs[i]));
+                continue;
+            }
+            if (kept != i) {
+                npcs[kept] = std::move(npcs[i]);
+            }
+            ++kept;
+        }
+        npcs.resize(kept);
+        it = npcs.empty() ? chunks_.erase(it) : std::next(it);
+    }
+
+    for (auto& npc : migrants) {
+        chunks_[chunkOf(npc->getX(), npc->getY())].npcs.push_back(std::move(npc));
+    }
+}
+
+void Dungeon::recordCheckpointLocked() {
+    for (const auto& [coord, chunk] : chunks_) {
+        for (const auto& npc : chunk.npcs) {
+            journal_->record(*npc);
+        }
+    }
+    // Из кладбища — только попавшие туда с прошлого тика
+    for (; journaledGraveyard_ < graveyard_.size(); ++journaledGraveyard_) {
+        journal_->record(*graveyard_[journaledGraveyard_]);
+    }
+}
+
+void Dungeon::finishTrajectoryFrameLocked() {
+    // Мёртвые не двигаются: достаточно один раз записать их смерть
+    for (; recordedGraveyard_ < graveyard_.size(); ++recordedGraveyard_) {
+        trajectory_->record(*graveyard_[recordedGraveyard_]);
+    }
+    trajectory_->endFrame();
+}
+
+void Dungeon::replaceAllLocked(std::vector<std::unique_ptr<NPC>> npcs) {
+    lazy_.reset();
+    lazyPending_ = false;
+    chunks_.clear();
+    sweep_.clear();
+    sweepDirty_ = true;
+    graveyard_.clear();
+    journaledGraveyard_ = 0;
+    recordedGraveyard_ = 0;
+    if (trajectory_) {
+        trajectory_->reset();
+    }
+    maxKillDistance_ = 0.0;
+    if (journal_) {
+        journal_->reset();
+    }
+    for (auto& npc : npcs) {
+        insertLocked(std::move(npc));
+    }
+}
+
+void Dungeon::materializeLocked(RegionKey key) {
+    for (auto& npc : lazy_->take(key)) {
+        insertLocked(std::move(npc));
+    }
+}
+
+void Dungeon::prepareLazy() {
+    if (!lazyPending_.load()) {
+        return;
+    }
+    std::shared_ptr<LazyRegions> lazy;
+    {
+        std::shared_lock<ProfiledSharedMutex> lock(npcsMutex_);
+        if (journal_ && journal_->snapshotDue()) {
+            lazy = lazy_;
+        }
+    }
+    // Перед снимком журнала мир будится целиком; чтение файла не должно держать блокировку мира
+    if (lazy) {
+        lazy->prepareAll();
+    }
+}
+
+void Dungeon::materializeTouchedLocked() {
+    if (!lazy_) {
+        return;
+    }
+    const RegionSnapshot& snapshot = lazy_->snapshot();
+    std::vector<RegionKey> touched;
+    auto touch = [&](double lowX, double lowY, double highX, double highY) {
+        const RegionKey low = snapshot.regionOf(lowX - maxKillDistance_, lowY - maxKillDistance_);
+        const RegionKey high = snapshot.regionOf(highX + maxKillDistance_, highY + maxKillDistance_);
+        for (int x = low.x; x <= high.x; ++x) {
+            for (int y = low.y; y <= high.y; ++y) {
+                touched.push_back(RegionKey{x, y});
+            }
+        }
+    };
+    for (const auto& [coord, chunk] : chunks_) {
+        const double x = NPC::MAP_MIN + coord.x * config_.chunkSize;
+        const double y = NPC::MAP_MIN + coord.y * config_.chunkSize;
+        touch(x, y, x + config_.chunkSize, y + config_.chunkSize);
+    }
+    // Разбуженные NPC могут дотянуться до следующей области: её фон уже построил
+    while (true) {
+        std::sort(touched.begin(), touched.end());
+        touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+        auto loaded = lazy_->claim(touched);
+        touched.clear();
+        if (loaded.empty()) break;
+        for (auto& [key, npcs] : loaded) {
+            for (auto& npc : npcs) {
+                if (npc->isAlive()) {
+                    touch(npc->getX(), npc->getY(), npc->getX(), npc->getY());
+                }
+                insertLocked(std::move(npc));
+            }
+        }
+    }
+    retireLazyLocked();
+}
+
+void Dungeon::materializeAllLocked() {
+    if (!lazy_) {
+        return;
+    }
+    for (const auto& region : lazy_->snapshot().regions()) {
+        materializeLocked(region.key);
+    }
+    retireLazyLocked();
+}
+
+void Dungeon::requestLazy(const Viewport* area) const {
+    if (!lazyPending_.load()) {
+        return;
+    }
+    std::shared_ptr<LazyRegions> lazy;
+    {
+        std::shared_lock<ProfiledSharedMutex> lock(npcsMutex_);
+        lazy = lazy_;
+    }
+    if (!lazy) {
+        return;
+    }
+    const RegionSnapshot& snapshot = lazy->snapshot();
+    std::vector<RegionKey> keys;
+    for (const auto& region : snapshot.regions()) {
+        keys.push_back(region.key);
+    }
+    if (area) {
+        const RegionKey low = snapshot.regionOf(area->x, area->y);
+        const RegionKey high = snapshot.regionOf(area->x + area->width, area->y + area->height);
+        std::erase_if(keys, [&](RegionKey key) {
+            return key.x < low.x || key.y < low.y || key.x > high.x || key.y > high.y;
+        });
+    }
+    lazy->want(keys);
+    lazy->prepare(keys);
+}
+
+void Dungeon::retireLazyLocked() {
+    if (lazy_ && lazy_->dormant() == 0) {
+        lazy_.reset();
+        lazyPending_ = false;
+    }
+}
@@ -0,0 +1,213 @@
+#include "event_log.hpp"
+#include "npc.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+constexpr char MAGIC[4] = {'D', 'K', 'E', 'V'};
+constexpr std::uint8_t VERSION = 1;
+
+enum RecordKind : std::uint8_t { KillKind = 1, NameKind = 2 };
+
+void putVarint(std::vector<char>& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+std::uint64_t zigzag(std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+bool getVarint(const unsigned char*& at, const unsigned char* end, std::uint64_t& value) {
+    value = 0;
+    for (int shift = 0; at < end && shift < 64; shift += 7) {
+        unsigned char byte = *at++;
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+// Тело записи не длиннее байта длины
+void closeRecord(std::vector<char>& out, std::size_t start) {
+    const std::size_t size = out.size() - start - 1;
+    if (size > UINT8_MAX) {
+        out.resize(start);
+        throw std::length_error("Event record is too long");
+    }
+    out[start] = static_cast<char>(size);
+}
+}
+
+BinaryEventLog::BinaryEventLog(const std::string& filename, std::function<std::uint64_t()> tickSource, std::size_t bufferSize)
+    : file_(std::fopen(filename.c_str(), "wb")), tickSource_(std::move(tickSource)), bufferSize_(bufferSize) {
+    if (file_ == nullptr) {
+        throw std::runtime_error("Failed to open event log " + filename);
+    }
+    buffer_.reserve(bufferSize_ + UINT8_MAX + 1);
+    buffer_.insert(buffer_.end(), std::begin(MAGIC), std::end(MAGIC));
+    buffer_.push_back(static_cast<char>(VERSION));
+    flushLocked();
+}
+
+BinaryEventLog::~BinaryEventLog() {
+    flush();
+    std::fclose(file_);
+}
+
+void BinaryEventLog::onKill(const std::string& killer, const std::string& victim) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    append(Species::Unknown, Species::Unknown, idFor(killer), idFor(victim), 0.0f, 0.0f);
+}
+
+void BinaryEventLog::onKillEvent(const NPC& killer, const NPC& victim) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    append(killer.getSpecies(), victim.getSpecies(), idFor(killer.getName()), idFor(victim.getName()),
+           static_cast<float>(victim.getX()), static_cast<float>(victim.getY()));
+}
+
+void BinaryEventLog::flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flushLocked();
+}
+
+std::uint64_t BinaryEventLog::idFor(const std::string& name) {
+    auto [it, inserted] = ids_.try_emplace(name, ids_.size());
+    if (inserted) {
+        const std::size_t start = buffer_.size();
+        buffer_.push_back(0);
+        buffer_.push_back(static_cast<char>(NameKind));
+        putVarint(buffer_, it->second);
+        // Длинное имя обрезается по байту длины: исключение из наблюдателя убило бы поток боя
+        const std::size_t room = UINT8_MAX - (buffer_.size() - start - 1);
+        buffer_.insert(buffer_.end(), name.begin(), name.begin() + static_cast<std::ptrdiff_t>(std::min(name.size(), room)));
+        closeRecord(buffer_, start);
+    }
+    return it->second;
+}
+
+void BinaryEventLog::append(Species killer, Species victim, std::uint64_t killerId, std::uint64_t victimId, float x, float y) {
+    const std::uint64_t tick = tickSource_ ? tickSource_() : lastTick_;
+    const std::size_t start = buffer_.size();
+    buffer_.push_back(0);
+    buffer_.push_back(static_cast<char>(KillKind));
+    buffer_.push_back(static_cast<char>(killer));
+    buffer_.push_back(static_cast<char>(victim));
+    const char* position[2] = {reinterpret_cast<const char*>(&x), reinterpret_cast<const char*>(&y)};
+    for (const char* bytes : position) {
+        buffer_.insert(buffer_.end(), bytes, bytes + sizeof(float));
+    }
+    // Тик почти не убывает: пишется знаковая дельта, чтобы пережить рестарт счётчика
+    putVarint(buffer_, zigzag(static_cast<std::int64_t>(tick - lastTick_)));
+    putVarint(buffer_, zigzag(static_cast<std::int64_t>(killerId - lastKillerId_)));
+    putVarint(buffer_, zigzag(static_cast<std::int64_t>(victimId - killerId)));
+    closeRecord(buffer_, start);
+
+    lastTick_ = tick;
+    lastKillerId_ = killerId;
+    if (buffer_.size() >= bufferSize_) {
+        flushLocked();
+    }
+}
+
+void BinaryEventLog::flushLocked() {
+    if (buffer_.empty()) {
+        return;
+    }
+    std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    std::fflush(file_);
+    buffer_.clear();
+}
+
+EventLogReader::EventLogReader(const std::string& filename) : file_(std::fopen(filename.c_str(), "rb")) {
+    if (file_ == nullptr) {
+        throw std::runtime_error("Failed to open event log " + filename);
+    }
+}
+
+EventLogReader::~EventLogReader() {
+    std::fclose(file_);
+}
+
+std::size_t EventLogReader::poll(const std::function<void(const KillRecord&)>& fn) {
+    constexpr std::size_t CHUNK = 1 << 20;
+    std::size_t records = 0;
+
+    while (true) {
+        const std::size_t kept = pending_.size();
+        pending_.resize(kept + CHUNK);
+        std::clearerr(file_);
+        const std::size_t got = std::fread(pending_.data() + kept, 1, CHUNK, file_);
+        pending_.resize(kept + got);
+        if (got == 0) {
+            break;
+        }
+
+        const auto* at = reinterpret_cast<const unsigned char*>(pending_.data());
+        const auto* end = at + pending_.size();
+
+        if (!headerRead_) {
+            if (end - at < 5) continue;
+            if (std::memcmp(at, MAGIC, 4) != 0 || at[4] != VERSION) {
+                throw std::runtime_error("Not a dungeon event log");
+            }
+            at += 5;
+            headerRead_ = true;
+        }
+
+        while (at < end && static_cast<std::size_t>(end - at) > *at) {
+            const unsigned char* body = at + 1;
+            const unsigned char* bodyEnd = body + *at;
+            at = bodyEnd;
+            if (body == bodyEnd) continue;
+
+            if (*body == NameKind) {
+                const unsigned char* cursor = body + 1;
+                std::uint64_t id = 0;
+                if (!getVarint(cursor, bodyEnd, id)) continue;
+                if (names_.size() <= id) names_.resize(id + 1);
+                names_[id].assign(reinterpret_cast<const char*>(cursor), static_cast<std::size_t>(bodyEnd - cursor));
+                continue;
+            }
+            if (*body != KillKind || bodyEnd - body < 11) continue;
+
+            if (body[1] >= SPECIES_COUNT || body[2] >= SPECIES_COUNT) {
+                throw std::runtime_error("Event log is corrupt: bad species");
+            }
+            KillRecord record{};
+            record.killerSpecies = static_cast<Species>(body[1]);
+            record.victimSpecies = static_cast<Species>(body[2]);
+            std::memcpy(&record.x, body + 3, sizeof(float));
+            std::memcpy(&record.y, body + 7, sizeof(float));
+            const unsigned char* cursor = body + 11;
+            std::uint64_t tickDelta = 0, killerDelta = 0, victimDelta = 0;
+            if (!getVarint(cursor, bodyEnd, tickDelta) || !getVarint(cursor, bodyEnd, killerDelta) || !getVarint(cursor, bodyEnd, victimDelta)) {
+                continue;
+            }
+            tick_ += static_cast<std::uint64_t>(unzigzag(tickDelta));
+            killerId_ += static_cast<std::uint64_t>(unzigzag(killerDelta));
+            record.tick = tick_;
+            record.killerId = killerId_;
+            record.victimId = killerId_ + static_cast<std::uint64_t>(unzigzag(victimDelta));
+            fn(record);
+            ++records;
+        }
+
+        pending_.erase(pending_.begin(), pending_.begin() + (reinterpret_cast<const char*>(at) - pending_.data()));
+    }
+    return records;
+}
+
+const std::string& EventLogReader::nameOf(std::uint64_t id) const {
+    static const std::string unknown = "?";
+    return id < names_.size() ? names_[id] : unknown;
+}
@@ -5,18 +5,18 @@
 #include <fstream>
 #include <sstream>
 
-std::unique_ptr<NPC> NPCFactory::createNPC(const std::string& type, const std::string& name, double x, double y) {
+std::unique_ptr<NPC> NPCFactory::createNPC(const std::string& type, const std::string& name, double x, double y, const WorldBounds& bounds) {
     if (type == "Bear") {
-        return std::make_unique<Bear>(name, x, y);
+        return std::make_unique<Bear>(name, x, y, bounds);
     } else if (type == "Heron") {
-        return std::make_unique<Heron>(name, x, y);
+        return std::make_unique<Heron>(name, x, y, bounds);
     } else if (type == "Desman") {
-        return std::make_unique<Desman>(name, x, y);
+        return std::make_unique<Desman>(name, x, y, bounds);
     }
     return nullptr;
 }
 
-std::vector<std::unique_ptr<NPC>> NPCFactory::loadFromFile(const std::string& filename) {
+std::vector<std::unique_ptr<NPC>> NPCFactory::loadFromFile(const std::string& filename, const WorldBounds& bounds) {
     std::vector<std::unique_ptr<NPC>> npcs;
     std::ifstream file(filename);
     std::string line;
@@ -25,7 +25,7 @@ std::vector<std::unique_ptr<NPC>> NPCFactory::loadFromFile(const std::string& fi
         std::string type, name;
         double x, y;
         if (iss >> type >> name >> x >> y) {
-            auto npc = createNPC(type, name, x, y);
+            auto npc = createNPC(type, name, x, y, bounds);
             if (npc) {
                 npcs.push_back(std::move(npc));
             }
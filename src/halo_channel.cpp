@@ -0,0 +1,100 @@
+#include "halo_channel.hpp"
+#include "npc.hpp"
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Shared memory ring needs lock-free 64-bit atomics");
+
+namespace {
+void copyField(char* dst, std::size_t size, const std::string& value, const char* field) {
+    if (value.size() >= size) {
+        throw std::length_error(std::string("NPC ") + field + " is too long for a halo record: " + value);
+    }
+    std::memcpy(dst, value.data(), value.size());
+    dst[value.size()] = '\0';
+}
+}
+
+NPCRecord NPCRecord::fromNPC(const NPC& npc, Kind kind, std::uint64_t tick) {
+    NPCRecord record;
+    record.tick = tick;
+    record.x = npc.getX();
+    record.y = npc.getY();
+    record.kind = kind;
+    copyField(record.type, TYPE_SIZE, npc.getType(), "type");
+    copyField(record.name, NAME_SIZE, npc.getName(), "name");
+    return record;
+}
+
+NPCRecord NPCRecord::marker(Kind kind, std::uint64_t tick) {
+    NPCRecord record;
+    record.tick = tick;
+    record.kind = kind;
+    return record;
+}
+
+SharedMemoryRing::SharedMemoryRing(std::size_t capacity)
+    : capacity_(capacity), bytes_(sizeof(Header) + capacity * sizeof(NPCRecord)) {
+    if (capacity_ == 0) {
+        throw std::invalid_argument("Ring capacity must be positive");
+    }
+    memory_ = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory_ == MAP_FAILED) {
+        throw std::runtime_error("Failed to map shared memory ring");
+    }
+    header_ = new (memory_) Header{};
+    header_->head.store(0);
+    header_->tail.store(0);
+    slots_ = reinterpret_cast<NPCRecord*>(static_cast<char*>(memory_) + sizeof(Header));
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+    munmap(memory_, bytes_);
+}
+
+bool SharedMemoryRing::tryPush(const NPCRecord& record) {
+    const auto head = header_->head.load(std::memory_order_relaxed);
+    if (head - header_->tail.load(std::memory_order_acquire) == capacity_) {
+        return false;
+    }
+    std::memcpy(&slots_[head % capacity_], &record, sizeof(NPCRecord));
+    header_->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool SharedMemoryRing::tryPop(NPCRecord& record) {
+    const auto tail = header_->tail.load(std::memory_order_relaxed);
+    if (tail == header_->head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    std::memcpy(&record, &slots_[tail % capacity_], sizeof(NPCRecord));
+    header_->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+LocalChannel::LocalChannel(std::size_t capacity) : capacity_(capacity) {
+    if (capacity_ == 0) {
+        throw std::invalid_argument("Channel capacity must be positive");
+    }
+}
+
+bool LocalChannel::tryPush(const NPCRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (records_.size() == capacity_) {
+        return false;
+    }
+    records_.push_back(record);
+    return true;
+}
+
+bool LocalChannel::tryPop(NPCRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (records_.empty()) {
+        return false;
+    }
+    record = records_.front();
+    records_.pop_front();
+    return true;
+}
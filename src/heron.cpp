@@ -1,8 +1,8 @@
 #include "heron.hpp"
 #include "battle_visitor.hpp"
 
-Heron::Heron(const std::string& name, double x, double y)
-    : NPC(name, x, y, "Heron", 50.0, 10.0) {}
+Heron::Heron(const std::string& name, double x, double y, const WorldBounds& bounds)
+    : NPC(name, x, y, "Heron", 50.0, 10.0, bounds) {}
 
 void Heron::accept(Visitor& visitor) {
     visitor.visitHeron(*this);
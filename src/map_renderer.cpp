@@ -0,0 +1,142 @@
+#include "map_renderer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+MapRenderer::MapRenderer(const RenderConfig& config) : config_(config) {
+    if (config_.columns <= 0 || config_.rows <= 0) {
+        throw std::invalid_argument("Map grid must have positive size");
+    }
+    const auto cells = static_cast<std::size_t>(config_.columns) * static_cast<std::size_t>(config_.rows);
+    cells_.assign(cells, ' ');
+    shown_.assign(cells, ' ');
+    if (config_.ansiDiff && config_.fd >= 0 && !fitsTerminal()) {
+        config_.ansiDiff = false;
+    }
+}
+
+// Построчный режим ставит курсор на абсолютные строки: кадр с заголовком,
+// рамкой и хотя бы одной строкой прокрутки под ним должен поместиться без переносов
+bool MapRenderer::fitsTerminal() const {
+    winsize size{};
+    if (::ioctl(config_.fd, TIOCGWINSZ, &size) != 0) {
+        return false;
+    }
+    return size.ws_row >= config_.rows + 3 && size.ws_col >= config_.columns * 3;
+}
+
+MapRenderer::~MapRenderer() {
+    if (config_.ansiDiff && !firstFrame_) {
+        // Вернуть терминалу прокрутку на весь экран, курсор — в конец
+        writeOut("\x1b[r\x1b[999;1H");
+    }
+}
+
+Viewport MapRenderer::visibleArea(const WorldBounds& bounds) const {
+    Viewport area = config_.viewport;
+    if (area.width <= 0.0 || area.height <= 0.0) {
+        area = Viewport{NPC::MAP_MIN, NPC::MAP_MIN, bounds.width, bounds.height};
+    }
+    return area;
+}
+
+void MapRenderer::beginFrame(const WorldBounds& bounds) {
+    area_ = visibleArea(bounds);
+    std::fill(cells_.begin(), cells_.end(), ' ');
+}
+
+void MapRenderer::plot(double x, double y, char mark) {
+    if (x < area_.x || y < area_.y || x > area_.x + area_.width || y > area_.y + area_.height) {
+        return;
+    }
+    int gx = static_cast<int>((x - area_.x) / area_.width * config_.columns);
+    int gy = static_cast<int>((y - area_.y) / area_.height * config_.rows);
+    gx = std::clamp(gx, 0, config_.columns - 1);
+    gy = std::clamp(gy, 0, config_.rows - 1);
+
+    char& cell = cells_[static_cast<std::size_t>(gy) * config_.columns + gx];
+    cell = (cell != ' ' && cell != mark) ? '*' : mark;
+}
+
+std::size_t MapRenderer::present() {
+    out_.clear();
+    const std::string header = "=== Map " + std::to_string(config_.columns) + "x" + std::to_string(config_.rows) + " ===\n";
+    const std::string footer = "================\n";
+
+    if (config_.ansiDiff && !firstFrame_ && config_.fd >= 0 && !fitsTerminal()) {
+        // Терминал уменьшили: область прокрутки снимается, дальше — целые кадры
+        config_.ansiDiff = false;
+        out_ += "\x1b[r\x1b[2J\x1b[H";
+        shown_.assign(shown_.size(), '\0');
+    }
+
+    if (firstFrame_ || !config_.ansiDiff) {
+        if (!firstFrame_ && cells_ == shown_) {
+            return 0;
+        }
+        if (config_.ansiDiff) {
+            out_ += "\x1b[2J\x1b[H";
+        }
+        out_ += header;
+        for (int row = 0; row < config_.rows; ++row) {
+            appendRow(row);
+        }
+        out_ += footer;
+        if (config_.ansiDiff) {
+            // Остальной вывод прокручивается под картой и не сдвигает её
+            const std::string below = std::to_string(config_.rows + 3);
+            out_ += "\x1b[" + below + "r\x1b[" + below + ";1H";
+        }
+    } else {
+        // Строка кадра r — строка терминала r + 2 (первая занята заголовком)
+        out_ += "\x1b" "7";
+        for (int row = 0; row < config_.rows; ++row) {
+            const auto begin = static_cast<std::size_t>(row) * config_.columns;
+            if (std::equal(cells_.begin() + begin, cells_.begin() + begin + config_.columns, shown_.begin() + begin)) {
+                continue;
+            }
+            out_ += "\x1b[" + std::to_string(row + 2) + ";1H";
+            appendRow(row);
+        }
+        if (out_.size() == 2) {
+            out_.clear();
+        } else {
+            out_ += "\x1b" "8";
+        }
+    }
+
+    shown_ = cells_;
+    firstFrame_ = false;
+
+    writeOut(out_);
+    return out_.size();
+}
+
+void MapRenderer::writeOut(const std::string& bytes) const {
+    // Остальная программа пишет через std::cout: его буфер уходит раньше кадра
+    if (config_.fd == STDOUT_FILENO && !bytes.empty()) {
+        std::cout.flush();
+    }
+    std::size_t written = 0;
+    while (config_.fd >= 0 && written < bytes.size()) {
+        ssize_t n = ::write(config_.fd, bytes.data() + written, bytes.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += static_cast<std::size_t>(n);
+    }
+}
+
+void MapRenderer::appendRow(int row) {
+    const auto begin = static_cast<std::size_t>(row) * config_.columns;
+    for (int column = 0; column < config_.columns; ++column) {
+        out_ += '[';
+        out_ += cells_[begin + column];
+        out_ += ']';
+    }
+    out_ += '\n';
+}
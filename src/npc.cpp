@@ -1,14 +1,34 @@
 #include "npc.hpp"
 #include <cmath>
 
-NPC::NPC(const std::string& name, double x, double y, const std::string& type, double moveDistance, double killDistance)
-    : name_(name), x_(x), y_(y), type_(type), moveDistance_(moveDistance), killDistance_(killDistance) {
+NPC::NPC(const std::string& name, double x, double y, const std::string& type, double moveDistance, double killDistance, const WorldBounds& bounds)
+    : name_(name), x_(x), y_(y), type_(type), species_(speciesOf(type)), moveDistance_(moveDistance), killDistance_(killDistance), bounds_(bounds) {
     validateCoordinates(x, y);
 }
 
+Species speciesOf(const std::string& type) {
+    if (type == "Bear") return Species::Bear;
+    if (type == "Heron") return Species::Heron;
+    if (type == "Desman") return Species::Desman;
+    return Species::Unknown;
+}
+
+const char* speciesName(Species species) {
+    switch (species) {
+        case Species::Bear: return "Bear";
+        case Species::Heron: return "Heron";
+        case Species::Desman: return "Desman";
+        default: return "Unknown";
+    }
+}
+
 void NPC::validateCoordinates(double x, double y) const {
-    if (x < MAP_MIN || x > MAP_MAX || y < MAP_MIN || y > MAP_MAX) {
-        throw std::out_of_range("Coordinates must be in range [0, 50]");
+    validateCoordinates(x, y, bounds_);
+}
+
+void NPC::validateCoordinates(double x, double y, const WorldBounds& bounds) {
+    if (x < MAP_MIN || x > bounds.width || y < MAP_MIN || y > bounds.height) {
+        throw std::out_of_range("Coordinates must be in range [0, " + std::to_string(bounds.width) + "] x [0, " + std::to_string(bounds.height) + "]");
     }
 }
 
@@ -16,9 +36,17 @@ const std::string& NPC::getName() const { return name_; }
 double NPC::getX() const { return x_; }
 double NPC::getY() const { return y_; }
 const std::string& NPC::getType() const { return type_; }
+Species NPC::getSpecies() const { return species_; }
 double NPC::getMoveDistance() const { return moveDistance_; }
 double NPC::getKillDistance() const { return killDistance_; }
 
+const WorldBounds& NPC::getBounds() const { return bounds_; }
+
+void NPC::setBounds(const WorldBounds& bounds) {
+    validateCoordinates(x_, y_, bounds);
+    bounds_ = bounds;
+}
+
 bool NPC::isAlive() const { return alive_.load(); }
 
 void NPC::kill() { alive_.store(false); }
@@ -30,8 +58,8 @@ void NPC::setPosition(double x, double y) {
 }
 
 void NPC::moveBy(double dx, double dy) {
-    double newX = std::clamp(x_ + dx, MAP_MIN, MAP_MAX);
-    double newY = std::clamp(y_ + dy, MAP_MIN, MAP_MAX);
+    double newX = std::clamp(x_ + dx, MAP_MIN, bounds_.width);
+    double newY = std::clamp(y_ + dy, MAP_MIN, bounds_.height);
     setPosition(newX, newY);
 }
 
@@ -0,0 +1,38 @@
+#include "npc_id_map.hpp"
+#include <algorithm>
+
+namespace {
+std::size_t slotOf(const void* key, std::size_t capacity) {
+    const auto hash = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(key)) * 0x9e3779b97f4a7c15ull;
+    return static_cast<std::size_t>(hash >> 32) & (capacity - 1);
+}
+}
+
+std::uint32_t NpcIdMap::idOf(const NPC& npc, bool& added) {
+    if ((count_ + 1) * 2 > slots_.size()) {
+        std::vector<Slot> old(std::max<std::size_t>(slots_.size() * 2, 1024), Slot{nullptr, 0});
+        old.swap(slots_);
+        for (const auto& slot : old) {
+            if (slot.npc == nullptr) continue;
+            std::size_t at = slotOf(slot.npc, slots_.size());
+            while (slots_[at].npc != nullptr) at = (at + 1) & (slots_.size() - 1);
+            slots_[at] = slot;
+        }
+    }
+    std::size_t at = slotOf(&npc, slots_.size());
+    while (slots_[at].npc != nullptr) {
+        if (slots_[at].npc == &npc) {
+            added = false;
+            return slots_[at].id;
+        }
+        at = (at + 1) & (slots_.size() - 1);
+    }
+    slots_[at] = Slot{&npc, static_cast<std::uint32_t>(count_++)};
+    added = true;
+    return slots_[at].id;
+}
+
+void NpcIdMap::clear() {
+    slots_.clear();
+    count_ = 0;
+}
@@ -0,0 +1,6 @@
+#include "observer.hpp"
+#include "npc.hpp"
+
+void Observer::onKillEvent(const NPC& killer, const NPC& victim) {
+    onKill(killer.getName(), victim.getName());
+}
\ No newline at end of file
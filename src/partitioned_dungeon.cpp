@@ -0,0 +1,464 @@
+#include "partitioned_dungeon.hpp"
+#include "battle_visitor.hpp"
+#include "dice.hpp"
+#include "factory.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+// В режиме потоков наблюдатели общие для всех полос
+class SerializedObserver : public Observer {
+public:
+    SerializedObserver(std::shared_ptr<Observer> inner, std::shared_ptr<std::mutex> mutex)
+        : inner_(std::move(inner)), mutex_(std::move(mutex)) {}
+
+    void onKill(const std::string& killer, const std::string& victim) override {
+        std::lock_guard<std::mutex> lock(*mutex_);
+        inner_->onKill(killer, victim);
+    }
+
+    void onKillEvent(const NPC& killer, const NPC& victim) override {
+        std::lock_guard<std::mutex> lock(*mutex_);
+        inner_->onKillEvent(killer, victim);
+    }
+
+private:
+    std::shared_ptr<Observer> inner_;
+    std::shared_ptr<std::mutex> mutex_;
+};
+
+void pushBlocking(HaloChannel& channel, const NPCRecord& record) {
+    while (!channel.tryPush(record)) {
+        std::this_thread::yield();
+    }
+}
+
+// В режиме процессов буферы наблюдателей дочернего процесса пропали бы при _exit:
+// убийства уходят родителю по каналу итогов, и наблюдатели вызываются там
+class KillForwarder : public Observer {
+public:
+    explicit KillForwarder(HaloChannel& results) : results_(results) {}
+
+    void onKill(const std::string&, const std::string&) override {}
+
+    void onKillEvent(const NPC& killer, const NPC& victim) override {
+        pushBlocking(results_, NPCRecord::fromNPC(killer, NPCRecord::Killer, 0));
+        pushBlocking(results_, NPCRecord::fromNPC(victim, NPCRecord::Victim, 0));
+    }
+
+private:
+    HaloChannel& results_;
+};
+}
+
+PartitionedDungeon::PartitionedDungeon(const PartitionConfig& config) : config_(config), workers_(config.workers) {
+    if (config_.workers == 0) {
+        throw std::invalid_argument("Partitioned dungeon needs at least one worker");
+    }
+    if (config_.channelCapacity == 0) {
+        throw std::invalid_argument("Channel capacity must be positive");
+    }
+}
+
+std::size_t PartitionedDungeon::stripOf(double y) const {
+    const double height = config_.dungeon.bounds.height / static_cast<double>(workers_);
+    const auto strip = static_cast<long long>(y / height);
+    return static_cast<std::size_t>(std::clamp<long long>(strip, 0, static_cast<long long>(workers_) - 1));
+}
+
+double PartitionedDungeon::stripLow(std::size_t strip) const {
+    return config_.dungeon.bounds.height * static_cast<double>(strip) / static_cast<double>(workers_);
+}
+
+double PartitionedDungeon::stripHigh(std::size_t strip) const {
+    return config_.dungeon.bounds.height * static_cast<double>(strip + 1) / static_cast<double>(workers_);
+}
+
+std::vector<std::string> PartitionedDungeon::run(std::vector<std::unique_ptr<NPC>> npcs, std::vector<std::shared_ptr<Observer>> observers) {
+    double haloWidth = config_.haloWidth;
+    double moveDistance = 0.0;
+    for (const auto& npc : npcs) {
+        if (!npc) continue;
+        if (config_.haloWidth <= 0.0) {
+            haloWidth = std::max(haloWidth, npc->getKillDistance());
+        }
+        moveDistance = std::max(moveDistance, npc->getMoveDistance());
+    }
+
+    // Halo уходит только к соседним полосам: полоса ниже дальности боя
+    // потеряла бы бои через одну полосу, поэтому полос становится меньше
+    workers_ = config_.workers;
+    if (haloWidth > 0.0) {
+        const auto fit = static_cast<std::size_t>(config_.dungeon.bounds.height / haloWidth);
+        workers_ = std::clamp<std::size_t>(fit, 1, config_.workers);
+    }
+    const std::size_t workers = workers_;
+    // Мигрант за тик может перелететь несколько полос: столько раундов пересылки
+    const double stripHeight = config_.dungeon.bounds.height / static_cast<double>(workers);
+    const auto hops = std::clamp<std::size_t>(static_cast<std::size_t>(std::ceil(moveDistance / stripHeight)), 1, std::max<std::size_t>(workers - 1, 1));
+
+    std::vector<std::vector<std::unique_ptr<NPC>>> strips(workers);
+    for (auto& npc : npcs) {
+        if (npc) {
+            strips[stripOf(npc->getY())].push_back(std::move(npc));
+        }
+    }
+
+    auto makeChannel = [&]() -> std::unique_ptr<HaloChannel> {
+        if (config_.useProcesses) {
+            return std::make_unique<SharedMemoryRing>(config_.channelCapacity);
+        }
+        return std::make_unique<LocalChannel>(config_.channelCapacity);
+    };
+
+    // Граница b разделяет полосы b и b + 1: по каналу в каждую сторону
+    std::vector<std::unique_ptr<HaloChannel>> upward, downward, results;
+    for (std::size_t b = 0; b + 1 < workers; ++b) {
+        upward.push_back(makeChannel());
+        downward.push_back(makeChannel());
+    }
+    for (std::size_t w = 0; w < workers; ++w) {
+        results.push_back(makeChannel());
+    }
+
+    std::atomic<bool> abort{false};
+    std::vector<Links> links(workers);
+    for (std::size_t w = 0; w < workers; ++w) {
+        if (w > 0) {
+            links[w].fromDown = upward[w - 1].get();
+            links[w].toDown = downward[w - 1].get();
+        }
+        if (w + 1 < workers) {
+            links[w].fromUp = downward[w].get();
+            links[w].toUp = upward[w].get();
+        }
+        links[w].results = results[w].get();
+        links[w].abort = &abort;
+    }
+
+    std::vector<pid_t> pids;
+    std::vector<std::thread> threads;
+    std::vector<std::atomic<bool>> finished(workers);
+    std::vector<std::exception_ptr> errors(workers);
+
+    if (config_.useProcesses) {
+        std::cout.flush();
+        std::cerr.flush();
+        for (std::size_t w = 0; w < workers; ++w) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                for (pid_t started : pids) {
+                    kill(started, SIGKILL);
+                    waitpid(started, nullptr, 0);
+                }
+                throw std::runtime_error("Failed to fork strip worker");
+            }
+            if (pid == 0) {
+                int status = 0;
+                try {
+                    runStrip(w, std::move(strips[w]), links[w], haloWidth, hops, {std::make_shared<KillForwarder>(*links[w].results)});
+                } catch (const std::exception& e) {
+                    std::cerr << "Strip " << w << " failed: " << e.what() << std::endl;
+                    status = 1;
+                }
+                std::cout.flush();
+                _exit(status);
+            }
+            pids.push_back(pid);
+        }
+        strips.clear();
+    } else {
+        auto mutex = std::make_shared<std::mutex>();
+        std::vector<std::shared_ptr<Observer>> serialized;
+        for (auto& obs : observers) {
+            serialized.push_back(std::make_shared<SerializedObserver>(obs, mutex));
+        }
+        for (std::size_t w = 0; w < workers; ++w) {
+            threads.emplace_back([&, w, serialized]() {
+                try {
+                    runStrip(w, std::move(strips[w]), links[w], haloWidth, hops, serialized);
+                } catch (...) {
+                    errors[w] = std::current_exception();
+                    abort.store(true);
+                }
+                finished[w].store(true);
+            });
+        }
+    }
+
+    std::vector<int> statuses(workers, 0);
+    std::vector<bool> exited(workers, false);
+    auto hasExited = [&](std::size_t w) {
+        if (!config_.useProcesses) {
+            return finished[w].load();
+        }
+        if (!exited[w] && waitpid(pids[w], &statuses[w], WNOHANG) == pids[w]) {
+            exited[w] = true;
+        }
+        return static_cast<bool>(exited[w]);
+    };
+
+    std::vector<std::string> survivors;
+    std::vector<bool> done(workers, false);
+    std::vector<NPCRecord> killers(workers);
+    std::size_t remaining = workers;
+    bool failed = false;
+
+    auto drain = [&](std::size_t w) {
+        bool progress = false;
+        NPCRecord record;
+        while (!done[w] && results[w]->tryPop(record)) {
+            progress = true;
+            if (record.kind == NPCRecord::EndOfResults) {
+                done[w] = true;
+                --remaining;
+            } else if (record.kind == NPCRecord::Killer) {
+                killers[w] = record;
+            } else if (record.kind == NPCRecord::Victim) {
+                notifyKill(killers[w], record, observers);
+            } else {
+                survivors.emplace_back(record.name);
+            }
+        }
+        return progress;
+    };
+
+    while (remaining > 0 && !failed) {
+        bool progress = false;
+        for (std::size_t w = 0; w < workers; ++w) {
+            progress = drain(w) || progress;
+        }
+        if (progress) {
+            continue;
+        }
+        for (std::size_t w = 0; w < workers; ++w) {
+            // Воркер мог записать итог прямо перед выходом
+            if (!done[w] && hasExited(w) && !drain(w) && !done[w]) {
+                failed = true;
+            }
+        }
+        std::this_thread::yield();
+    }
+
+    if (config_.useProcesses) {
+        for (std::size_t w = 0; w < workers; ++w) {
+            if (failed && !exited[w]) {
+                kill(pids[w], SIGKILL);
+            }
+            if (!exited[w]) {
+                waitpid(pids[w], &statuses[w], 0);
+            }
+            if (!WIFEXITED(statuses[w]) || WEXITSTATUS(statuses[w]) != 0) {
+                failed = true;
+            }
+        }
+        if (failed) {
+            throw std::runtime_error("Strip worker process failed");
+        }
+    } else {
+        if (failed) {
+            abort.store(true);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    return survivors;
+}
+
+void PartitionedDungeon::runStrip(std::size_t strip, std::vector<std::unique_ptr<NPC>> npcs, const Links& links, double haloWidth, std::size_t hops, std::vector<std::shared_ptr<Observer>> observers) const {
+    Dungeon dungeon(config_.dungeon);
+    for (auto& npc : npcs) {
+        dungeon.addNPC(std::move(npc));
+    }
+
+    std::unordered_set<std::string> killed;
+    const double low = stripLow(strip);
+    const double high = stripHigh(strip);
+    const WorldBounds& bounds = config_.dungeon.bounds;
+
+    // Убитые за тик умирают в его конце: атакует каждый, кто был жив в начале,
+    // и итог не зависит от порядка боёв, а значит, и от разбиения на полосы
+    std::unordered_set<NPC*> fallen;
+    auto attack = [&](NPC& attacker, NPC& defender, std::uint64_t tick) {
+        if (fallen.count(&defender) != 0) {
+            return;
+        }
+        auto [attackRoll, defenseRoll] = pairDice(config_.seed, tick, attacker, defender);
+        BattleVisitor visitor(defender, observers, killed, attackRoll, defenseRoll);
+        attacker.accept(visitor);
+        if (visitor.didKill()) {
+            fallen.insert(&defender);
+        }
+    };
+
+    auto materialize = [&](const NPCRecord& record) {
+        return NPCFactory::createNPC(record.type, record.name, record.x, record.y, bounds);
+    };
+
+    std::vector<NPCRecord> toDown, toUp, incoming;
+    for (std::uint64_t tick = 0; tick < config_.ticks; ++tick) {
+        dungeon.moveAll(config_.seed, tick);
+
+        // Мигранты переходят к соседу целиком; улетевшие дальше соседа
+        // он пересылает в следующем раунде того же тика
+        toDown.clear();
+        toUp.clear();
+        for (auto& npc : dungeon.extractIf([&](const NPC& n) { return stripOf(n.getY()) != strip; })) {
+            auto& out = stripOf(npc->getY()) < strip ? toDown : toUp;
+            out.push_back(NPCRecord::fromNPC(*npc, NPCRecord::Migrant, tick));
+        }
+        for (std::size_t hop = 0; hop < hops; ++hop) {
+            exchange(links, toDown, toUp, incoming, tick);
+            toDown.clear();
+            toUp.clear();
+            for (const auto& record : incoming) {
+                const std::size_t owner = stripOf(record.y);
+                if (owner < strip) {
+                    toDown.push_back(record);
+                } else if (owner > strip) {
+                    toUp.push_back(record);
+                } else if (auto npc = materialize(record)) {
+                    dungeon.addNPC(std::move(npc));
+                }
+            }
+        }
+        if (!toDown.empty() || !toUp.empty()) {
+            throw std::logic_error("Migrant crossed more strips than the exchange allows");
+        }
+
+        // Halo: копии приграничных NPC для боёв через границу
+        toDown.clear();
+        toUp.clear();
+        std::vector<NPC*> border;
+        dungeon.forEachAlive([&](NPC& npc) {
+            bool nearDown = links.toDown != nullptr && npc.getY() < low + haloWidth;
+            bool nearUp = links.toUp != nullptr && npc.getY() >= high - haloWidth;
+            if (nearDown) toDown.push_back(NPCRecord::fromNPC(npc, NPCRecord::Halo, tick));
+            if (nearUp) toUp.push_back(NPCRecord::fromNPC(npc, NPCRecord::Halo, tick));
+            if (nearDown || nearUp) border.push_back(&npc);
+        });
+        exchange(links, toDown, toUp, incoming, tick);
+
+        std::vector<std::unique_ptr<NPC>> ghosts;
+        for (const auto& record : incoming) {
+            if (auto npc = materialize(record)) {
+                ghosts.push_back(std::move(npc));
+            }
+        }
+        std::sort(ghosts.begin(), ghosts.end(), [](const auto& a, const auto& b) { return a->getX() < b->getX(); });
+
+        // Каждая полоса решает только атаки на своих NPC: чужих убьёт их владелец
+        // теми же бросками. Все пограничные бои — по состоянию на начало тика.
+        for (NPC* own : border) {
+            auto it = std::lower_bound(ghosts.begin(), ghosts.end(), own->getX() - haloWidth,
+                                       [](const auto& ghost, double x) { return ghost->getX() < x; });
+            for (; it != ghosts.end() && (*it)->getX() <= own->getX() + haloWidth && fallen.count(own) == 0; ++it) {
+                if (own->distanceTo(**it) <= (*it)->getKillDistance()) {
+                    attack(**it, *own, tick);
+                }
+            }
+        }
+
+        dungeon.forEachPairInRange(dungeon.maxKillDistance(), [&](NPC& a, NPC& b) {
+            double distance = a.distanceTo(b);
+            if (distance <= a.getKillDistance() && a.isAlive() && b.isAlive()) {
+                attack(a, b, tick);
+            }
+            if (distance <= b.getKillDistance() && a.isAlive() && b.isAlive()) {
+                attack(b, a, tick);
+            }
+        });
+        for (NPC* npc : fallen) {
+            npc->kill();
+        }
+        fallen.clear();
+    }
+
+    dungeon.forEachAlive([&](NPC& npc) {
+        pushBlocking(*links.results, NPCRecord::fromNPC(npc, NPCRecord::Survivor, config_.ticks));
+    });
+    pushBlocking(*links.results, NPCRecord::marker(NPCRecord::EndOfResults, config_.ticks));
+}
+
+void PartitionedDungeon::notifyKill(const NPCRecord& killerRecord, const NPCRecord& victimRecord, const std::vector<std::shared_ptr<Observer>>& observers) const {
+    const WorldBounds& bounds = config_.dungeon.bounds;
+    auto killer = NPCFactory::createNPC(killerRecord.type, killerRecord.name, killerRecord.x, killerRecord.y, bounds);
+    auto victim = NPCFactory::createNPC(victimRecord.type, victimRecord.name, victimRecord.x, victimRecord.y, bounds);
+    if (!killer || !victim) {
+        return;
+    }
+    victim->kill();
+    for (const auto& obs : observers) {
+        obs->onKillEvent(*killer, *victim);
+    }
+}
+
+void PartitionedDungeon::exchange(const Links& links, std::vector<NPCRecord> toDown, std::vector<NPCRecord> toUp, std::vector<NPCRecord>& incoming, std::uint64_t tick) const {
+    if (links.toDown) toDown.push_back(NPCRecord::marker(NPCRecord::EndOfPhase, tick));
+    if (links.toUp) toUp.push_back(NPCRecord::marker(NPCRecord::EndOfPhase, tick));
+
+    // Отправка и приём чередуются, иначе два соседа с полными кольцами ждали бы друг друга
+    std::vector<NPCRecord> fromDown, fromUp;
+    std::size_t sentDown = 0, sentUp = 0;
+    bool gotDown = links.fromDown == nullptr;
+    bool gotUp = links.fromUp == nullptr;
+
+    auto receive = [&](HaloChannel* channel, std::vector<NPCRecord>& out, bool& got) {
+        bool progress = false;
+        NPCRecord record;
+        while (!got && channel->tryPop(record)) {
+            progress = true;
+            if (record.kind != NPCRecord::EndOfPhase) {
+                out.push_back(record);
+                continue;
+            }
+            if (record.tick != tick) {
+                throw std::logic_error("Halo exchange out of sync between strips");
+            }
+            got = true;
+        }
+        return progress;
+    };
+
+    while (sentDown < toDown.size() || sentUp < toUp.size() || !gotDown || !gotUp) {
+        bool progress = false;
+        while (sentDown < toDown.size() && links.toDown->tryPush(toDown[sentDown])) {
+            ++sentDown;
+            progress = true;
+        }
+        while (sentUp < toUp.size() && links.toUp->tryPush(toUp[sentUp])) {
+            ++sentUp;
+            progress = true;
+        }
+        progress = receive(links.fromDown, fromDown, gotDown) || progress;
+        progress = receive(links.fromUp, fromUp, gotUp) || progress;
+
+        if (!progress) {
+            if (links.abort != nullptr && links.abort->load()) {
+                throw std::runtime_error("Partitioned simulation aborted");
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    // Фиксированный порядок приёма сохраняет детерминизм
+    incoming = std::move(fromDown);
+    incoming.insert(incoming.end(), fromUp.begin(), fromUp.end());
+}
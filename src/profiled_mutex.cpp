@@ -0,0 +1,250 @@
+#include "profiled_mutex.hpp"
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+thread_local LockSite currentSite = LockSite::Other;
+
+// Разделяемые захваты учитываются по потоку: владельцев может быть несколько
+struct SharedHold {
+    const void* mutex;
+    Clock::time_point acquiredAt;
+    LockSite site;
+};
+thread_local std::vector<SharedHold> sharedHolds;
+
+std::size_t bucketOf(std::chrono::nanoseconds duration) {
+    const auto ns = static_cast<std::uint64_t>(std::max<std::chrono::nanoseconds::rep>(duration.count(), 0));
+    return std::min<std::size_t>(static_cast<std::size_t>(std::bit_width(ns)), LOCK_HISTOGRAM_BUCKETS - 1);
+}
+
+std::chrono::nanoseconds percentile(const std::array<std::uint64_t, LOCK_HISTOGRAM_BUCKETS>& histogram, double q) {
+    std::uint64_t total = 0;
+    for (auto count : histogram) total += count;
+    if (total == 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    const auto rank = static_cast<std::uint64_t>(q * static_cast<double>(total - 1));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < histogram.size(); ++i) {
+        seen += histogram[i];
+        if (seen > rank) {
+            return std::chrono::nanoseconds(i == 0 ? 0 : (std::uint64_t{1} << i) - 1);
+        }
+    }
+    return std::chrono::nanoseconds((std::uint64_t{1} << (LOCK_HISTOGRAM_BUCKETS - 1)) - 1);
+}
+
+template <typename Counters>
+void add(Counters& counters, std::chrono::nanoseconds duration) {
+    counters[bucketOf(duration)].fetch_add(1, std::memory_order_relaxed);
+}
+}
+
+const char* lockSiteName(LockSite site) {
+    switch (site) {
+        case LockSite::MovementLoop: return "movementLoop";
+        case LockSite::BattleLoop: return "battleLoop";
+        case LockSite::PrintMap: return "printMap";
+        case LockSite::Survivors: return "survivors";
+        case LockSite::AddNPC: return "addNPC";
+        case LockSite::SaveToFile: return "saveToFile";
+        case LockSite::Pacing: return "pacing";
+        default: return "other";
+    }
+}
+
+LockSiteScope::LockSiteScope(LockSite site) : previous_(currentSite) {
+    currentSite = site;
+}
+
+LockSiteScope::~LockSiteScope() {
+    currentSite = previous_;
+}
+
+std::chrono::nanoseconds LockSiteStats::waitPercentile(double q) const {
+    return percentile(waitHistogram, q);
+}
+
+std::chrono::nanoseconds LockSiteStats::holdPercentile(double q) const {
+    return percentile(holdHistogram, q);
+}
+
+LockProfile::LockProfile(std::string name) : name_(std::move(name)) {}
+
+void LockProfile::recordWait(LockSite site, std::chrono::nanoseconds wait) {
+    auto& counters = sites_[static_cast<std::size_t>(site)];
+    counters.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    counters.waitNs.fetch_add(static_cast<std::uint64_t>(wait.count()), std::memory_order_relaxed);
+    add(counters.waitHistogram, wait);
+}
+
+void LockProfile::recordHold(LockSite site, std::chrono::nanoseconds hold) {
+    auto& counters = sites_[static_cast<std::size_t>(site)];
+    counters.holdNs.fetch_add(static_cast<std::uint64_t>(hold.count()), std::memory_order_relaxed);
+    add(counters.holdHistogram, hold);
+}
+
+std::vector<LockSiteStats> LockProfile::snapshot() const {
+    std::vector<LockSiteStats> result;
+    for (std::size_t i = 0; i < LOCK_SITE_COUNT; ++i) {
+        const auto& counters = sites_[i];
+        const auto acquisitions = counters.acquisitions.load(std::memory_order_relaxed);
+        if (acquisitions == 0) continue;
+
+        LockSiteStats stats{};
+        stats.mutex = name_;
+        stats.site = static_cast<LockSite>(i);
+        stats.acquisitions = acquisitions;
+        stats.totalWait = std::chrono::nanoseconds(counters.waitNs.load(std::memory_order_relaxed));
+        stats.totalHold = std::chrono::nanoseconds(counters.holdNs.load(std::memory_order_relaxed));
+        for (std::size_t b = 0; b < LOCK_HISTOGRAM_BUCKETS; ++b) {
+            stats.waitHistogram[b] = counters.waitHistogram[b].load(std::memory_order_relaxed);
+            stats.holdHistogram[b] = counters.holdHistogram[b].load(std::memory_order_relaxed);
+        }
+        result.push_back(stats);
+    }
+    return result;
+}
+
+ProfiledMutex::ProfiledMutex(std::string name) : profile_(std::move(name)) {}
+
+void ProfiledMutex::lock() {
+    if (!profile_.enabled()) {
+        mutex_.lock();
+        profiledHold_ = false;
+        return;
+    }
+    const auto start = Clock::now();
+    mutex_.lock();
+    acquired(start);
+}
+
+bool ProfiledMutex::try_lock() {
+    const bool profiled = profile_.enabled();
+    const auto start = profiled ? Clock::now() : Clock::time_point{};
+    if (!mutex_.try_lock()) {
+        return false;
+    }
+    if (profiled) {
+        acquired(start);
+    } else {
+        profiledHold_ = false;
+    }
+    return true;
+}
+
+void ProfiledMutex::unlock() {
+    if (profiledHold_) {
+        profile_.recordHold(holderSite_, Clock::now() - acquiredAt_);
+    }
+    mutex_.unlock();
+}
+
+void ProfiledMutex::acquired(Clock::time_point start) {
+    acquiredAt_ = Clock::now();
+    holderSite_ = currentSite;
+    profiledHold_ = true;
+    profile_.recordWait(holderSite_, acquiredAt_ - start);
+}
+
+ProfiledSharedMutex::ProfiledSharedMutex(std::string name) : profile_(std::move(name)) {}
+
+void ProfiledSharedMutex::lock() {
+    if (!profile_.enabled()) {
+        mutex_.lock();
+        profiledHold_ = false;
+        return;
+    }
+    const auto start = Clock::now();
+    mutex_.lock();
+    acquired(start);
+}
+
+bool ProfiledSharedMutex::try_lock() {
+    const bool profiled = profile_.enabled();
+    const auto start = profiled ? Clock::now() : Clock::time_point{};
+    if (!mutex_.try_lock()) {
+        return false;
+    }
+    if (profiled) {
+        acquired(start);
+    } else {
+        profiledHold_ = false;
+    }
+    return true;
+}
+
+void ProfiledSharedMutex::unlock() {
+    if (profiledHold_) {
+        profile_.recordHold(holderSite_, Clock::now() - acquiredAt_);
+    }
+    mutex_.unlock();
+}
+
+void ProfiledSharedMutex::lock_shared() {
+    if (!profile_.enabled()) {
+        mutex_.lock_shared();
+        return;
+    }
+    const auto start = Clock::now();
+    mutex_.lock_shared();
+    acquiredShared(start);
+}
+
+bool ProfiledSharedMutex::try_lock_shared() {
+    const bool profiled = profile_.enabled();
+    const auto start = profiled ? Clock::now() : Clock::time_point{};
+    if (!mutex_.try_lock_shared()) {
+        return false;
+    }
+    if (profiled) {
+        acquiredShared(start);
+    }
+    return true;
+}
+
+void ProfiledSharedMutex::unlock_shared() {
+    for (auto it = sharedHolds.rbegin(); it != sharedHolds.rend(); ++it) {
+        if (it->mutex == this) {
+            profile_.recordHold(it->site, Clock::now() - it->acquiredAt);
+            sharedHolds.erase(std::next(it).base());
+            break;
+        }
+    }
+    mutex_.unlock_shared();
+}
+
+void ProfiledSharedMutex::acquired(Clock::time_point start) {
+    acquiredAt_ = Clock::now();
+    holderSite_ = currentSite;
+    profiledHold_ = true;
+    profile_.recordWait(holderSite_, acquiredAt_ - start);
+}
+
+void ProfiledSharedMutex::acquiredShared(Clock::time_point start) {
+    const auto now = Clock::now();
+    sharedHolds.push_back(SharedHold{this, now, currentSite});
+    profile_.recordWait(currentSite, now - start);
+}
+
+void dumpLockStats(std::ostream& out, const std::vector<LockSiteStats>& stats) {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+
+    out << "=== Lock contention (us) ===" << std::endl;
+    out << std::left << std::setw(14) << "mutex" << std::setw(14) << "site" << std::right
+        << std::setw(10) << "acquired" << std::setw(12) << "wait total" << std::setw(10) << "wait p99"
+        << std::setw(12) << "hold total" << std::setw(10) << "hold p99" << std::endl;
+    for (const auto& row : stats) {
+        out << std::left << std::setw(14) << row.mutex << std::setw(14) << lockSiteName(row.site) << std::right
+            << std::setw(10) << row.acquisitions
+            << std::setw(12) << duration_cast<microseconds>(row.totalWait).count()
+            << std::setw(10) << duration_cast<microseconds>(row.waitPercentile(0.99)).count()
+            << std::setw(12) << duration_cast<microseconds>(row.totalHold).count()
+            << std::setw(10) << duration_cast<microseconds>(row.holdPercentile(0.99)).count() << std::endl;
+    }
+}
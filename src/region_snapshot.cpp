@@ -0,0 +1,376 @@
+#include "region_snapshot.hpp"
+#include "factory.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+constexpr char REGION_MAGIC[4] = {'D', 'R', 'G', 'N'};
+constexpr std::uint32_t REGION_VERSION = 1;
+constexpr std::size_t HEADER_SIZE = sizeof(REGION_MAGIC) + sizeof(std::uint32_t) + 2 * sizeof(double) + sizeof(std::uint32_t);
+constexpr std::size_t ENTRY_SIZE = 3 * sizeof(std::int32_t) + 2 * sizeof(std::uint64_t);
+
+template <typename T>
+void put(std::vector<char>& out, const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void putString(std::vector<char>& out, const std::string& value) {
+    if (value.size() > UINT16_MAX) {
+        throw std::length_error("Region snapshot string is too long: " + value.substr(0, 32));
+    }
+    put(out, static_cast<std::uint16_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+class Reader {
+public:
+    Reader(const char* data, std::size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    T get() {
+        if (size_ - offset_ < sizeof(T)) {
+            throw std::runtime_error("Region snapshot is truncated");
+        }
+        T value;
+        std::memcpy(&value, data_ + offset_, sizeof(T));
+        offset_ += sizeof(T);
+        return value;
+    }
+
+    std::string getString() {
+        const auto size = get<std::uint16_t>();
+        if (size_ - offset_ < size) {
+            throw std::runtime_error("Region snapshot is truncated");
+        }
+        std::string value(data_ + offset_, size);
+        offset_ += size;
+        return value;
+    }
+
+private:
+    const char* data_;
+    std::size_t size_;
+    std::size_t offset_{0};
+};
+
+RegionKey regionAt(double x, double y, double regionSize) {
+    return RegionKey{std::max(0, static_cast<int>((x - NPC::MAP_MIN) / regionSize)),
+                     std::max(0, static_cast<int>((y - NPC::MAP_MIN) / regionSize))};
+}
+
+std::vector<char> readRange(const std::string& filename, std::uint64_t offset, std::uint64_t size) {
+    std::ifstream file(filename, std::ios::binary);
+    std::vector<char> data(size);
+    if (!file.seekg(static_cast<std::streamoff>(offset)) || !file.read(data.data(), static_cast<std::streamsize>(size))) {
+        throw std::runtime_error("Cannot read region snapshot: " + filename);
+    }
+    return data;
+}
+}
+
+RegionSnapshot::RegionSnapshot(const std::string& filename) : filename_(filename) {
+    std::vector<char> header = readRange(filename, 0, HEADER_SIZE);
+    if (std::memcmp(header.data(), REGION_MAGIC, sizeof(REGION_MAGIC)) != 0) {
+        throw std::runtime_error("Not a region snapshot: " + filename);
+    }
+    Reader reader(header.data() + sizeof(REGION_MAGIC), header.size() - sizeof(REGION_MAGIC));
+    if (reader.get<std::uint32_t>() != REGION_VERSION) {
+        throw std::runtime_error("Unsupported region snapshot version: " + filename);
+    }
+    regionSize_ = reader.get<double>();
+    maxKillDistance_ = reader.get<double>();
+    const auto count = reader.get<std::uint32_t>();
+    if (!(regionSize_ > 0.0)) {
+        throw std::runtime_error("Region snapshot has bad region size: " + filename);
+    }
+
+    std::vector<char> index = readRange(filename, HEADER_SIZE, std::uint64_t{count} * ENTRY_SIZE);
+    Reader entries(index.data(), index.size());
+    const std::uint64_t fileSize = std::uint64_t{HEADER_SIZE} + index.size();
+    regions_.reserve(count);
+    for (std::uint32_t i = 0; i < count; ++i) {
+        Region region{};
+        region.key.x = entries.get<std::int32_t>();
+        region.key.y = entries.get<std::int32_t>();
+        region.count = entries.get<std::uint32_t>();
+        region.offset = entries.get<std::uint64_t>();
+        region.size = entries.get<std::uint64_t>();
+        if (region.offset < fileSize) {
+            throw std::runtime_error("Region snapshot index is corrupt: " + filename);
+        }
+        regions_.push_back(region);
+    }
+}
+
+void RegionSnapshot::write(const std::string& filename, const std::vector<const NPC*>& npcs, double regionSize) {
+    if (!(regionSize > 0.0)) {
+        throw std::invalid_argument("Region size must be positive");
+    }
+    std::map<RegionKey, std::pair<std::uint32_t, std::vector<char>>> payloads;
+    double maxKillDistance = 0.0;
+    for (const NPC* npc : npcs) {
+        auto& [count, out] = payloads[regionAt(npc->getX(), npc->getY(), regionSize)];
+        ++count;
+        put(out, npc->getX());
+        put(out, npc->getY());
+        put(out, static_cast<std::uint8_t>(npc->isAlive()));
+        putString(out, npc->getType());
+        putString(out, npc->getName());
+        maxKillDistance = std::max(maxKillDistance, npc->getKillDistance());
+    }
+
+    std::vector<char> header;
+    header.insert(header.end(), REGION_MAGIC, REGION_MAGIC + sizeof(REGION_MAGIC));
+    put(header, REGION_VERSION);
+    put(header, regionSize);
+    put(header, maxKillDistance);
+    put(header, static_cast<std::uint32_t>(payloads.size()));
+    std::uint64_t offset = HEADER_SIZE + payloads.size() * ENTRY_SIZE;
+    for (const auto& [key, payload] : payloads) {
+        put(header, static_cast<std::int32_t>(key.x));
+        put(header, static_cast<std::int32_t>(key.y));
+        put(header, payload.first);
+        put(header, offset);
+        put(header, static_cast<std::uint64_t>(payload.second.size()));
+        offset += payload.second.size();
+    }
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    file.write(header.data(), static_cast<std::streamsize>(header.size()));
+    for (const auto& [key, payload] : payloads) {
+        file.write(payload.second.data(), static_cast<std::streamsize>(payload.second.size()));
+    }
+    if (!file.flush()) {
+        throw std::runtime_error("Cannot write region snapshot: " + filename);
+    }
+}
+
+bool RegionSnapshot::isSnapshot(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(REGION_MAGIC)] = {};
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, REGION_MAGIC, sizeof(magic)) == 0;
+}
+
+std::size_t RegionSnapshot::npcCount() const {
+    std::size_t count = 0;
+    for (const auto& region : regions_) {
+        count += region.count;
+    }
+    return count;
+}
+
+RegionKey RegionSnapshot::regionOf(double x, double y) const {
+    return regionAt(x, y, regionSize_);
+}
+
+std::vector<std::unique_ptr<NPC>> RegionSnapshot::load(const Region& region, const WorldBounds& bounds) const {
+    std::vector<char> data = readRange(filename_, region.offset, region.size);
+    Reader reader(data.data(), data.size());
+    std::vector<std::unique_ptr<NPC>> npcs;
+    npcs.reserve(region.count);
+    for (std::uint32_t i = 0; i < region.count; ++i) {
+        const auto x = reader.get<double>();
+        const auto y = reader.get<double>();
+        const bool alive = reader.get<std::uint8_t>() != 0;
+        const std::string type = reader.getString();
+        const std::string name = reader.getString();
+        auto npc = NPCFactory::createNPC(type, name, x, y, bounds);
+        if (!npc) continue;
+        if (!alive) {
+            npc->kill();
+        }
+        npcs.push_back(std::move(npc));
+    }
+    return npcs;
+}
+
+LazyRegions::LazyRegions(std::shared_ptr<const RegionSnapshot> snapshot, const WorldBounds& bounds)
+    : snapshot_(std::move(snapshot)), bounds_(bounds) {
+    reach_ = std::max(1, static_cast<int>(std::ceil(snapshot_->maxKillDistance() / snapshot_->regionSize())));
+    for (const auto& region : snapshot_->regions()) {
+        slots_.emplace(region.key, Slot{&region, State::Dormant, false, {}});
+    }
+    dormant_ = slots_.size();
+    worker_ = std::thread([this]() { run(); });
+}
+
+LazyRegions::~LazyRegions() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+std::size_t LazyRegions::dormant() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dormant_;
+}
+
+std::vector<std::unique_ptr<NPC>> LazyRegions::take(RegionKey key) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = slots_.find(key);
+    if (it == slots_.end()) {
+        return {};
+    }
+    Slot& slot = it->second;
+    cv_.wait(lock, [&]() { return slot.state != State::Loading; });
+    if (slot.state == State::Taken) {
+        return {};
+    }
+    if (slot.state == State::Ready) {
+        auto npcs = std::move(slot.npcs);
+        markTakenLocked(key);
+        return npcs;
+    }
+    markTakenLocked(key);
+    lock.unlock();
+    return snapshot_->load(*slot.region, bounds_);
+}
+
+LazyRegions::Loaded LazyRegions::claim(const std::vector<RegionKey>& keys) {
+    Loaded loaded;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (RegionKey key : keys) {
+            wantLocked(key);
+        }
+        std::erase_if(wanted_, [&](RegionKey key) {
+            Slot& slot = slots_.at(key);
+            if (slot.state == State::Ready) {
+                loaded.emplace_back(key, std::move(slot.npcs));
+                markTakenLocked(key);
+            }
+            return slot.state == State::Taken;
+        });
+    }
+    cv_.notify_all();
+    return loaded;
+}
+
+void LazyRegions::want(const std::vector<RegionKey>& keys) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (RegionKey key : keys) {
+            wantLocked(key);
+        }
+    }
+    cv_.notify_all();
+}
+
+void LazyRegions::prepare(const std::vector<RegionKey>& keys) {
+    for (RegionKey key : keys) {
+        if (slots_.count(key) != 0) {
+            prepare(key);
+        }
+    }
+}
+
+void LazyRegions::prepareAll() {
+    std::vector<RegionKey> keys;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [key, slot] : slots_) {
+            if (slot.state == State::Dormant || slot.state == State::Loading) {
+                keys.push_back(key);
+            }
+        }
+    }
+    for (RegionKey key : keys) {
+        prepare(key);
+    }
+}
+
+void LazyRegions::forEachReady(const std::function<void(const NPC&)>& fn) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [key, slot] : slots_) {
+        if (slot.state != State::Ready) continue;
+        for (const auto& npc : slot.npcs) {
+            fn(*npc);
+        }
+    }
+}
+
+void LazyRegions::prepare(RegionKey key) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Slot& slot = slots_.at(key);
+    cv_.wait(lock, [&]() { return slot.state != State::Loading; });
+    if (slot.state != State::Dormant) {
+        return;
+    }
+    slot.state = State::Loading;
+    lock.unlock();
+    std::vector<std::unique_ptr<NPC>> npcs;
+    try {
+        npcs = snapshot_->load(*slot.region, bounds_);
+    } catch (...) {
+        lock.lock();
+        slot.state = State::Dormant;
+        cv_.notify_all();
+        throw;
+    }
+    lock.lock();
+    slot.npcs = std::move(npcs);
+    slot.state = State::Ready;
+    cv_.notify_all();
+}
+
+void LazyRegions::markTakenLocked(RegionKey key) {
+    slots_.at(key).state = State::Taken;
+    --dormant_;
+    // Две досягаемости: соседи тех, кого отдадут следующими, к тому времени уже построены
+    const int ahead = 2 * reach_;
+    for (int dx = -ahead; dx <= ahead; ++dx) {
+        for (int dy = -ahead; dy <= ahead; ++dy) {
+            auto it = slots_.find(RegionKey{key.x + dx, key.y + dy});
+            if (it == slots_.end() || it->second.state != State::Dormant) continue;
+            prefetch_.push_back(it->first);
+        }
+    }
+    cv_.notify_all();
+}
+
+void LazyRegions::wantLocked(RegionKey key) {
+    auto it = slots_.find(key);
+    if (it == slots_.end() || it->second.state == State::Taken || it->second.wanted) {
+        return;
+    }
+    it->second.wanted = true;
+    wanted_.push_back(key);
+    if (it->second.state == State::Dormant) {
+        prefetch_.push_front(key);
+    }
+}
+
+bool LazyRegions::nextToLoadLocked(RegionKey& key) {
+    while (!prefetch_.empty()) {
+        key = prefetch_.front();
+        prefetch_.pop_front();
+        if (slots_.at(key).state == State::Dormant) return true;
+    }
+    return false;
+}
+
+void LazyRegions::run() {
+    RegionKey key{};
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&]() { return stop_ || nextToLoadLocked(key); });
+            if (stop_) return;
+        }
+        try {
+            prepare(key);
+        } catch (const std::exception&) {
+            // Ошибку получит тот, кто будет строить область сам
+            return;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(std::size_t threads) {
+    for (std::size_t i = 1; i < threads; ++i) {
+        workers_.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeCv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_ = &fn;
+    jobSize_ = count;
+    nextIndex_ = 0;
+    finished_ = 0;
+    error_ = nullptr;
+    ++generation_;
+    wakeCv_.notify_all();
+
+    runTasks(lock);
+    doneCv_.wait(lock, [&]() { return finished_ == jobSize_; });
+
+    job_ = nullptr;
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    std::size_t seenGeneration = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wakeCv_.wait(lock, [&]() { return stopping_ || generation_ != seenGeneration; });
+        if (stopping_) {
+            return;
+        }
+        seenGeneration = generation_;
+        runTasks(lock);
+    }
+}
+
+void ThreadPool::runTasks(std::unique_lock<std::mutex>& lock) {
+    while (job_ != nullptr && nextIndex_ < jobSize_) {
+        std::size_t index = nextIndex_++;
+        const auto& fn = *job_;
+        lock.unlock();
+        try {
+            fn(index);
+        } catch (...) {
+            lock.lock();
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+            lock.unlock();
+        }
+        lock.lock();
+        if (++finished_ == jobSize_) {
+            doneCv_.notify_all();
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#include "tick_pacer.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+constexpr double LATENCY_SMOOTHING = 0.1;
+constexpr double STRETCH = 1.5;
+constexpr double SHRINK = 0.8;
+}
+
+TickPacer::TickPacer(const PacingConfig& config) : config_(config), interval_(config.targetTick) {
+    if (config_.targetTick.count() <= 0 || config_.targetTick > config_.maxTick) {
+        throw std::invalid_argument("Pacing requires 0 < targetTick <= maxTick");
+    }
+    if (config_.queueCapacity == 0) {
+        throw std::invalid_argument("Fight queue capacity must be positive");
+    }
+    stats_.interval = config_.targetTick;
+}
+
+bool TickPacer::shouldScan(std::size_t queueDepth) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.ticks;
+    if (queueDepth >= watermark(config_.highWatermark)) {
+        ++stats_.skippedScans;
+        return false;
+    }
+    return true;
+}
+
+std::chrono::milliseconds TickPacer::nextInterval(std::chrono::nanoseconds work, std::size_t queueDepth) {
+    using std::chrono::nanoseconds;
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const nanoseconds target = config_.targetTick;
+    const bool drained = queueDepth <= watermark(config_.lowWatermark);
+    if (drained) {
+        // Задержка обновляется только разобранными боями; без них старая
+        // оценка держала бы интервал растянутым вечно
+        latencyEwma_ *= 1.0 - LATENCY_SMOOTHING;
+        stats_.battleLatency = std::chrono::microseconds(static_cast<std::chrono::microseconds::rep>(latencyEwma_ / 1000.0));
+    }
+    const bool behind = queueDepth >= watermark(config_.highWatermark) || (!drained && latencyEwma_ > static_cast<double>(target.count()));
+    const bool idle = drained && latencyEwma_ < static_cast<double>(target.count()) / 2;
+
+    if (behind) {
+        interval_ = nanoseconds(static_cast<nanoseconds::rep>(static_cast<double>(interval_.count()) * STRETCH));
+    } else if (idle) {
+        // Возврат к цели, а не ниже: бой успевает, ускорять движение незачем
+        interval_ = nanoseconds(static_cast<nanoseconds::rep>(static_cast<double>(interval_.count()) * SHRINK));
+    }
+    interval_ = std::clamp<nanoseconds>(interval_, target, config_.maxTick);
+
+    // Работа тика входит в его бюджет
+    const nanoseconds sleep = std::max<nanoseconds>(interval_ - work, nanoseconds(0));
+    stats_.interval = std::chrono::duration_cast<std::chrono::milliseconds>(interval_);
+    return std::chrono::duration_cast<std::chrono::milliseconds>(sleep);
+}
+
+void TickPacer::recordBattleLatency(std::chrono::nanoseconds latency) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latencyEwma_ += LATENCY_SMOOTHING * (static_cast<double>(latency.count()) - latencyEwma_);
+    stats_.battleLatency = std::chrono::microseconds(static_cast<std::chrono::microseconds::rep>(latencyEwma_ / 1000.0));
+}
+
+void TickPacer::recordDropped(std::size_t fights) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.droppedFights += fights;
+}
+
+PacingStats TickPacer::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::size_t TickPacer::watermark(double fraction) const {
+    return std::max<std::size_t>(1, static_cast<std::size_t>(fraction * static_cast<double>(config_.queueCapacity)));
+}
@@ -0,0 +1,474 @@
+#include "trajectory_recorder.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+constexpr char MAGIC[4] = {'D', 'K', 'T', 'R'};
+constexpr std::uint8_t VERSION = 1;
+
+void putVarint(std::vector<std::uint8_t>& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<std::uint8_t>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::uint64_t zigzag(std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+std::uint8_t* writeVarint(std::uint8_t* out, std::uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<std::uint8_t>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<std::uint8_t>(value);
+    return out;
+}
+
+void putString(std::vector<std::uint8_t>& out, const std::string& value) {
+    putVarint(out, value.size());
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+class BlockReader {
+public:
+    explicit BlockReader(const std::vector<std::uint8_t>& data) : at_(data.data()), end_(data.data() + data.size()) {}
+
+    std::uint64_t varint() {
+        std::uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            std::uint8_t byte = next();
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) return value;
+        }
+        throw std::runtime_error("Corrupted trajectory block: bad varint");
+    }
+
+    std::uint8_t next() {
+        if (at_ == end_) {
+            throw std::runtime_error("Corrupted trajectory block: unexpected end");
+        }
+        return *at_++;
+    }
+
+    std::string string() {
+        const std::uint64_t size = varint();
+        if (static_cast<std::uint64_t>(end_ - at_) < size) {
+            throw std::runtime_error("Corrupted trajectory block: string out of range");
+        }
+        std::string value(reinterpret_cast<const char*>(at_), size);
+        at_ += size;
+        return value;
+    }
+
+private:
+    const std::uint8_t* at_;
+    const std::uint8_t* end_;
+};
+
+// Упрощённый LZ77 в духе LZ4: токен (длина литералов | длина совпадения - 4),
+// литералы, 16-битное смещение. Нулевые дельты неподвижных и мёртвых NPC и
+// заполненные маски живых сжимаются в короткие повторы.
+constexpr std::size_t MIN_MATCH = 4;
+constexpr std::size_t MAX_OFFSET = UINT16_MAX;
+constexpr int HASH_BITS = 14;
+
+void putLength(std::vector<std::uint8_t>& out, std::size_t length) {
+    for (; length >= 255; length -= 255) {
+        out.push_back(255);
+    }
+    out.push_back(static_cast<std::uint8_t>(length));
+}
+
+void putSequence(std::vector<std::uint8_t>& out, const std::uint8_t* literals, std::size_t literalCount, std::size_t offset, std::size_t matchLength) {
+    const std::size_t matchCode = matchLength == 0 ? 0 : matchLength - MIN_MATCH;
+    out.push_back(static_cast<std::uint8_t>((std::min<std::size_t>(literalCount, 15) << 4) | std::min<std::size_t>(matchCode, 15)));
+    if (literalCount >= 15) {
+        putLength(out, literalCount - 15);
+    }
+    out.insert(out.end(), literals, literals + literalCount);
+    if (matchLength == 0) {
+        return;
+    }
+    out.push_back(static_cast<std::uint8_t>(offset & 0xff));
+    out.push_back(static_cast<std::uint8_t>(offset >> 8));
+    if (matchCode >= 15) {
+        putLength(out, matchCode - 15);
+    }
+}
+
+std::vector<std::uint8_t> compress(const std::vector<std::uint8_t>& in) {
+    std::vector<std::uint8_t> out;
+    out.reserve(in.size() / 2 + 16);
+    std::vector<std::uint32_t> table(std::size_t{1} << HASH_BITS, 0);
+
+    const std::size_t size = in.size();
+    std::size_t anchor = 0;
+    std::size_t i = 0;
+    // Как в LZ4: после серии промахов шаг растёт, несжимаемые участки
+    // (случайные дельты) проходятся быстро
+    std::size_t misses = 0;
+    while (i + MIN_MATCH <= size) {
+        std::uint32_t sequence;
+        std::memcpy(&sequence, in.data() + i, sizeof(sequence));
+        const std::uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        const std::size_t candidate = table[hash];
+        table[hash] = static_cast<std::uint32_t>(i + 1);
+
+        if (candidate != 0 && i - (candidate - 1) <= MAX_OFFSET && std::memcmp(in.data() + candidate - 1, in.data() + i, MIN_MATCH) == 0) {
+            const std::size_t match = candidate - 1;
+            std::size_t length = MIN_MATCH;
+            while (i + length < size && in[match + length] == in[i + length]) {
+                ++length;
+            }
+            putSequence(out, in.data() + anchor, i - anchor, i - match, length);
+            i += length;
+            anchor = i;
+            misses = 0;
+        } else {
+            i += 1 + (misses++ >> 5);
+        }
+    }
+    putSequence(out, in.data() + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+std::vector<std::uint8_t> decompress(const std::vector<std::uint8_t>& in, std::size_t rawSize) {
+    std::vector<std::uint8_t> out;
+    out.reserve(rawSize);
+    std::size_t at = 0;
+    auto fail = []() { throw std::runtime_error("Corrupted trajectory block: bad compressed data"); };
+    auto length = [&](std::size_t base) {
+        if (base < 15) return base;
+        while (true) {
+            if (at == in.size()) fail();
+            const std::uint8_t byte = in[at++];
+            base += byte;
+            if (byte != 255) return base;
+        }
+    };
+
+    while (at < in.size()) {
+        const std::uint8_t token = in[at++];
+        const std::size_t literals = length(token >> 4);
+        if (in.size() - at < literals || rawSize - out.size() < literals) fail();
+        out.insert(out.end(), in.begin() + static_cast<std::ptrdiff_t>(at), in.begin() + static_cast<std::ptrdiff_t>(at + literals));
+        at += literals;
+        if (at == in.size()) break;
+
+        if (in.size() - at < 2) fail();
+        const std::size_t offset = in[at] | (static_cast<std::size_t>(in[at + 1]) << 8);
+        at += 2;
+        const std::size_t match = length(token & 0x0f) + MIN_MATCH;
+        if (offset == 0 || offset > out.size() || rawSize - out.size() < match) fail();
+        // Совпадение может перекрываться с собой — копируем побайтно
+        const std::size_t from = out.size() - offset;
+        for (std::size_t k = 0; k < match; ++k) {
+            out.push_back(out[from + k]);
+        }
+    }
+    if (out.size() != rawSize) fail();
+    return out;
+}
+}
+
+TrajectoryRecorder::TrajectoryRecorder(const TrajectoryConfig& config) : config_(config), file_(std::fopen(config.filename.c_str(), "wb")) {
+    if (config_.sampleEvery == 0 || config_.framesPerBlock == 0 || config_.maxPendingBlocks == 0 || !(config_.quantum > 0.0)) {
+        if (file_ != nullptr) std::fclose(file_);
+        throw std::invalid_argument("Invalid trajectory recorder config");
+    }
+    if (file_ == nullptr) {
+        throw std::runtime_error("Failed to open trajectory file " + config_.filename);
+    }
+    std::fwrite(MAGIC, 1, sizeof(MAGIC), file_);
+    std::fwrite(&VERSION, 1, sizeof(VERSION), file_);
+    std::fwrite(&config_.quantum, sizeof(config_.quantum), 1, file_);
+    std::fflush(file_);
+
+    block_ = Block{false, 0, {}, {}, 0};
+    writer_ = std::thread(&TrajectoryRecorder::writerLoop, this);
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    writer_.join();
+    std::fclose(file_);
+}
+
+void TrajectoryRecorder::beginFrame(std::uint64_t tick) {
+    current_.tick = tick;
+    current_.x.resize(ids_.size());
+    current_.y.resize(ids_.size());
+    current_.alive.assign((ids_.size() + 7) / 8, 0);
+    current_.written.assign((ids_.size() + 7) / 8, 0);
+}
+
+void TrajectoryRecorder::record(const NPC& npc) {
+    bool added = false;
+    const std::uint32_t id = ids_.idOf(npc, added);
+    if (added) {
+        block_.identities.push_back(Identity{npc.getType(), npc.getName()});
+        current_.x.push_back(0);
+        current_.y.push_back(0);
+        current_.alive.resize((ids_.size() + 7) / 8, 0);
+        current_.written.resize((ids_.size() + 7) / 8, 0);
+    }
+    const auto bit = static_cast<std::uint8_t>(1u << (id % 8));
+    current_.x[id] = static_cast<std::int32_t>(std::lround(npc.getX() / config_.quantum));
+    current_.y[id] = static_cast<std::int32_t>(std::lround(npc.getY() / config_.quantum));
+    current_.written[id / 8] |= bit;
+    if (npc.isAlive()) {
+        current_.alive[id / 8] |= bit;
+    }
+}
+
+void TrajectoryRecorder::endFrame() {
+    block_.frames.push_back(std::move(current_));
+    current_ = Frame{};
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!spare_.empty()) {
+            current_ = std::move(spare_.back());
+            spare_.pop_back();
+        }
+    }
+    if (block_.frames.size() >= config_.framesPerBlock) {
+        queueBlock();
+    }
+}
+
+void TrajectoryRecorder::publish() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&]() { return pending_.size() <= config_.maxPendingBlocks; });
+}
+
+void TrajectoryRecorder::reset() {
+    if (!block_.frames.empty() || !block_.identities.empty()) {
+        queueBlock();
+    }
+    ids_.clear();
+    current_ = Frame{};
+    block_ = Block{true, 0, {}, {}, 0};
+}
+
+void TrajectoryRecorder::flush() {
+    if (!block_.frames.empty() || !block_.identities.empty() || block_.reset) {
+        queueBlock();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&]() { return pending_.empty() && !writing_; });
+}
+
+void TrajectoryRecorder::queueBlock() {
+    block_.npcCount = ids_.size();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(std::move(block_));
+    }
+    cv_.notify_all();
+    block_ = Block{false, static_cast<std::uint32_t>(ids_.size()), {}, {}, 0};
+}
+
+void TrajectoryRecorder::writerLoop() {
+    while (true) {
+        Block block;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&]() { return stop_ || !pending_.empty(); });
+            if (pending_.empty()) {
+                break;
+            }
+            block = std::move(pending_.front());
+            pending_.pop_front();
+            writing_ = true;
+        }
+        cv_.notify_all();
+
+        const std::size_t npcCount = block.npcCount;
+        if (block.reset) {
+            lastX_.clear();
+            lastY_.clear();
+        }
+        lastX_.resize(npcCount, 0);
+        lastY_.resize(npcCount, 0);
+        for (auto& frame : block.frames) {
+            for (std::size_t id = 0; id < frame.x.size(); ++id) {
+                if (frame.written[id / 8] & (1u << (id % 8))) {
+                    lastX_[id] = frame.x[id];
+                    lastY_[id] = frame.y[id];
+                } else {
+                    frame.x[id] = lastX_[id];
+                    frame.y[id] = lastY_[id];
+                }
+            }
+        }
+
+        std::vector<std::uint8_t> raw;
+        raw.push_back(static_cast<std::uint8_t>(block.reset));
+        putVarint(raw, block.firstNewId);
+        putVarint(raw, block.identities.size());
+        for (const auto& identity : block.identities) {
+            putString(raw, identity.type);
+            putString(raw, identity.name);
+        }
+        putVarint(raw, block.frames.size());
+        putVarint(raw, npcCount);
+
+        std::uint64_t lastTick = 0;
+        for (const auto& frame : block.frames) {
+            putVarint(raw, zigzag(static_cast<std::int64_t>(frame.tick - lastTick)));
+            lastTick = frame.tick;
+        }
+        const std::size_t maskBytes = (npcCount + 7) / 8;
+        for (const auto& frame : block.frames) {
+            raw.insert(raw.end(), frame.alive.begin(), frame.alive.end());
+            raw.resize(raw.size() + maskBytes - frame.alive.size(), 0);
+        }
+        // Столбцы: у соседних кадров одного NPC координаты близки,
+        // поэтому дельты по времени почти всегда умещаются в байт
+        const std::size_t maxColumnBytes = block.frames.size() * 10;
+        raw.reserve(raw.size() + npcCount * block.frames.size() * 4);
+        for (auto column : {&Frame::x, &Frame::y}) {
+            for (std::size_t id = 0; id < npcCount; ++id) {
+                const std::size_t start = raw.size();
+                raw.resize(start + maxColumnBytes);
+                std::uint8_t* out = raw.data() + start;
+                std::int32_t previous = 0;
+                for (const auto& frame : block.frames) {
+                    const auto& values = frame.*column;
+                    const std::int32_t value = id < values.size() ? values[id] : previous;
+                    out = writeVarint(out, zigzag(static_cast<std::int64_t>(value) - previous));
+                    previous = value;
+                }
+                raw.resize(static_cast<std::size_t>(out - raw.data()));
+            }
+        }
+
+        const auto packed = compress(raw);
+        const std::uint32_t sizes[2] = {static_cast<std::uint32_t>(raw.size()), static_cast<std::uint32_t>(packed.size())};
+        std::fwrite(sizes, sizeof(sizes[0]), 2, file_);
+        std::fwrite(packed.data(), 1, packed.size(), file_);
+        std::fflush(file_);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            writing_ = false;
+            for (auto& frame : block.frames) {
+                if (spare_.size() >= config_.framesPerBlock) break;
+                spare_.push_back(std::move(frame));
+            }
+        }
+        cv_.notify_all();
+    }
+}
+
+TrajectoryReader::TrajectoryReader(const std::string& filename) : file_(std::fopen(filename.c_str(), "rb")) {
+    if (file_ == nullptr) {
+        throw std::runtime_error("Failed to open trajectory file " + filename);
+    }
+    char magic[sizeof(MAGIC)];
+    std::uint8_t version = 0;
+    if (std::fread(magic, 1, sizeof(magic), file_) != sizeof(magic) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        std::fread(&version, 1, 1, file_) != 1 || version != VERSION || std::fread(&quantum_, sizeof(quantum_), 1, file_) != 1) {
+        std::fclose(file_);
+        throw std::runtime_error("Not a trajectory file: " + filename);
+    }
+}
+
+TrajectoryReader::~TrajectoryReader() {
+    std::fclose(file_);
+}
+
+const std::string& TrajectoryReader::nameOf(std::uint32_t id) const {
+    return names_.at(id);
+}
+
+const std::string& TrajectoryReader::typeOf(std::uint32_t id) const {
+    return types_.at(id);
+}
+
+bool TrajectoryReader::next(TrajectoryFrame& frame) {
+    while (nextFrame_ == frames_.size()) {
+        if (!readBlock()) {
+            return false;
+        }
+    }
+    frame = std::move(frames_[nextFrame_++]);
+    return true;
+}
+
+bool TrajectoryReader::readBlock() {
+    std::uint32_t sizes[2];
+    if (std::fread(sizes, sizeof(sizes[0]), 2, file_) != 2) {
+        return false;
+    }
+    std::vector<std::uint8_t> packed(sizes[1]);
+    if (std::fread(packed.data(), 1, packed.size(), file_) != packed.size()) {
+        // Блок ещё дописывается или файл обрезан
+        return false;
+    }
+    const auto raw = decompress(packed, sizes[0]);
+    BlockReader in(raw);
+
+    if (in.next() != 0) {
+        names_.clear();
+        types_.clear();
+    }
+    const std::uint64_t firstNewId = in.varint();
+    const std::uint64_t added = in.varint();
+    if (firstNewId != names_.size()) {
+        throw std::runtime_error("Corrupted trajectory block: identity gap");
+    }
+    for (std::uint64_t i = 0; i < added; ++i) {
+        types_.push_back(in.string());
+        names_.push_back(in.string());
+    }
+
+    const std::uint64_t frameCount = in.varint();
+    const std::uint64_t npcCount = in.varint();
+    if (npcCount != names_.size()) {
+        throw std::runtime_error("Corrupted trajectory block: NPC count mismatch");
+    }
+
+    frames_.assign(frameCount, TrajectoryFrame{});
+    std::uint64_t tick = 0;
+    for (auto& frame : frames_) {
+        tick += static_cast<std::uint64_t>(unzigzag(in.varint()));
+        frame.tick = tick;
+        frame.x.resize(npcCount);
+        frame.y.resize(npcCount);
+        frame.alive.resize(npcCount);
+    }
+    for (auto& frame : frames_) {
+        for (std::size_t byte = 0; byte < (npcCount + 7) / 8; ++byte) {
+            const std::uint8_t mask = in.next();
+            for (std::size_t bit = 0; bit < 8 && byte * 8 + bit < npcCount; ++bit) {
+                frame.alive[byte * 8 + bit] = (mask >> bit) & 1;
+            }
+        }
+    }
+    for (auto column : {&TrajectoryFrame::x, &TrajectoryFrame::y}) {
+        for (std::size_t id = 0; id < npcCount; ++id) {
+            std::int64_t value = 0;
+            for (auto& frame : frames_) {
+                value += unzigzag(in.varint());
+                (frame.*column)[id] = static_cast<double>(value) * quantum_;
+            }
+        }
+    }
+    nextFrame_ = 0;
+    return true;
+}
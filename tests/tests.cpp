@@ -3,12 +3,21 @@
 #include "factory.hpp"
 #include "console_observer.hpp"
 #include "file_observer.hpp"
+#include "partitioned_dungeon.hpp"
+#include "event_log.hpp"
+#include "battle_visitor.hpp"
+#include "dice.hpp"
 #include <memory>
 #include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <cstdio>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <random>
+#include <algorithm>
 
 // Перенаправление вывода для проверки
 class CaptureOutput {
@@ -299,4 +308,881 @@ TEST(DungeonTest, KilledNPCCannotCounterAttack) {
     dungeon.battle(0.5, observers);
     
     SUCCEED();
-}
\ No newline at end of file
+}
+
+// Мир настраиваемого размера
+TEST(NPCTest, CustomWorldBounds) {
+    WorldBounds bounds{100000.0, 2000.0};
+    auto npc = NPCFactory::createNPC("Bear", "Bear1", 99999.0, 1500.0, bounds);
+    ASSERT_NE(npc, nullptr);
+    EXPECT_EQ(npc->getX(), 99999.0);
+
+    EXPECT_THROW(NPCFactory::createNPC("Bear", "Bear2", 1000.0, 2500.0, bounds), std::out_of_range);
+    EXPECT_THROW(NPCFactory::createNPC("Bear", "Bear3", 1000.0, 10.0), std::out_of_range);
+}
+
+TEST(DungeonTest, InvalidConfig) {
+    DungeonConfig config;
+    config.chunkSize = 0.0;
+    EXPECT_THROW(Dungeon{config}, std::invalid_argument);
+}
+
+TEST(DungeonTest, LargeWorldSpawn) {
+    DungeonConfig config;
+    config.bounds = WorldBounds{100000.0, 100000.0};
+    config.chunkSize = 100.0;
+    Dungeon dungeon(config);
+    dungeon.spawnRandomNPCs(1000);
+
+    EXPECT_EQ(dungeon.survivors().size(), 1000u);
+    EXPECT_GT(dungeon.populatedChunks(), 0u);
+    EXPECT_LE(dungeon.populatedChunks(), 1000u);
+}
+
+// Чанки без живых NPC не считаются заселёнными
+TEST(DungeonTest, DeadChunksSkipped) {
+    DungeonConfig config;
+    config.bounds = WorldBounds{1000.0, 1000.0};
+    config.chunkSize = 50.0;
+    Dungeon dungeon(config);
+
+    auto far = NPCFactory::createNPC("Heron", "Heron1", 900.0, 900.0, config.bounds);
+    NPC* farRaw = far.get();
+    dungeon.addNPC(std::move(far));
+    dungeon.addNPC(NPCFactory::createNPC("Bear", "Bear1", 10.0, 10.0, config.bounds));
+    EXPECT_EQ(dungeon.populatedChunks(), 2u);
+
+    farRaw->kill();
+    EXPECT_EQ(dungeon.populatedChunks(), 1u);
+    EXPECT_EQ(dungeon.survivors().size(), 1u);
+}
+
+
+// Разбиение мира на полосы
+namespace {
+std::vector<std::unique_ptr<NPC>> makeMixedNPCs(const WorldBounds& bounds, std::size_t count) {
+    std::vector<std::unique_ptr<NPC>> npcs;
+    const std::vector<std::string> types = {"Bear", "Heron", "Desman"};
+    for (std::size_t i = 0; i < count; ++i) {
+        const std::string& type = types[i % types.size()];
+        double x = bounds.width * static_cast<double>((i * 37) % count) / static_cast<double>(count);
+        double y = bounds.height * static_cast<double>((i * 53) % count) / static_cast<double>(count);
+        npcs.push_back(NPCFactory::createNPC(type, type + std::to_string(i), x, y, bounds));
+    }
+    return npcs;
+}
+
+class CountingObserver : public Observer {
+public:
+    void onKill(const std::string& killer, const std::string& victim) override {
+        kills.push_back(killer + ">" + victim);
+    }
+
+    std::vector<std::string> kills;
+};
+
+// Эталон: тот же мир без разбиения, те же шаги, броски и правило боёв тика
+std::vector<std::string> runUnpartitioned(const PartitionConfig& config, std::vector<std::unique_ptr<NPC>> npcs) {
+    Dungeon dungeon(config.dungeon);
+    for (auto& npc : npcs) {
+        dungeon.addNPC(std::move(npc));
+    }
+    std::vector<std::shared_ptr<Observer>> observers;
+    std::unordered_set<std::string> killed;
+    std::unordered_set<NPC*> fallen;
+    for (std::uint64_t tick = 0; tick < config.ticks; ++tick) {
+        dungeon.moveAll(config.seed, tick);
+        auto attack = [&](NPC& attacker, NPC& defender) {
+            if (fallen.count(&defender) != 0) return;
+            auto [attackRoll, defenseRoll] = pairDice(config.seed, tick, attacker, defender);
+            BattleVisitor visitor(defender, observers, killed, attackRoll, defenseRoll);
+            attacker.accept(visitor);
+            if (visitor.didKill()) {
+                fallen.insert(&defender);
+            }
+        };
+        dungeon.forEachPairInRange(dungeon.maxKillDistance(), [&](NPC& a, NPC& b) {
+            if (a.distanceTo(b) <= a.getKillDistance()) attack(a, b);
+            if (a.distanceTo(b) <= b.getKillDistance()) attack(b, a);
+        });
+        for (NPC* npc : fallen) {
+            npc->kill();
+        }
+        fallen.clear();
+    }
+    auto alive = dungeon.survivors();
+    std::sort(alive.begin(), alive.end());
+    return alive;
+}
+}
+
+TEST(PartitionTest, InvalidWorkerCount) {
+    PartitionConfig config;
+    config.workers = 0;
+    EXPECT_THROW(PartitionedDungeon{config}, std::invalid_argument);
+}
+
+TEST(PartitionTest, HeronsMigrateWithoutLoss) {
+    PartitionConfig config;
+    config.dungeon.bounds = WorldBounds{200.0, 200.0};
+    config.workers = 4;
+    config.ticks = 20;
+    config.useProcesses = false;
+
+    std::vector<std::unique_ptr<NPC>> npcs;
+    for (int i = 0; i < 40; ++i) {
+        npcs.push_back(NPCFactory::createNPC("Heron", "Heron" + std::to_string(i), i * 5.0, i * 5.0, config.dungeon.bounds));
+    }
+
+    std::vector<std::shared_ptr<Observer>> observers;
+    auto alive = PartitionedDungeon(config).run(std::move(npcs), observers);
+    EXPECT_EQ(alive.size(), 40u);
+}
+
+// Процессы с разделяемой памятью и потоки с локальным транспортом дают одинаковый итог
+TEST(PartitionTest, ProcessesMatchThreads) {
+    PartitionConfig config;
+    config.dungeon.bounds = WorldBounds{150.0, 150.0};
+    config.workers = 3;
+    config.ticks = 15;
+    config.seed = 42;
+    config.channelCapacity = 16;
+
+    // Убийства из дочерних процессов доходят до наблюдателей родителя
+    auto processKills = std::make_shared<CountingObserver>();
+    auto threadKills = std::make_shared<CountingObserver>();
+
+    config.useProcesses = true;
+    auto fromProcesses = PartitionedDungeon(config).run(makeMixedNPCs(config.dungeon.bounds, 120), {processKills});
+    config.useProcesses = false;
+    auto fromThreads = PartitionedDungeon(config).run(makeMixedNPCs(config.dungeon.bounds, 120), {threadKills});
+
+    std::sort(fromProcesses.begin(), fromProcesses.end());
+    std::sort(fromThreads.begin(), fromThreads.end());
+    EXPECT_EQ(fromProcesses, fromThreads);
+    EXPECT_LT(fromThreads.size(), 120u);
+
+    std::sort(processKills->kills.begin(), processKills->kills.end());
+    std::sort(threadKills->kills.begin(), threadKills->kills.end());
+    EXPECT_EQ(processKills->kills, threadKills->kills);
+    EXPECT_EQ(threadKills->kills.size(), 120u - fromThreads.size());
+}
+
+// Полосы ниже дальности боя выхухоли: бои через полосу не теряются, итог как без разбиения
+TEST(PartitionTest, MatchesUnpartitionedDungeon) {
+    PartitionConfig config;
+    config.dungeon.bounds = WorldBounds{500.0, WorldBounds::DEFAULT_SIZE};
+    config.ticks = 1;
+    config.seed = 7;
+    config.useProcesses = false;
+
+    // Пары медведь — выхухоль по разные стороны средней из трёх полос высотой ~16.7
+    auto makeNPCs = [&]() {
+        std::vector<std::unique_ptr<NPC>> npcs;
+        for (int i = 0; i < 25; ++i) {
+            npcs.push_back(NPCFactory::createNPC("Bear", "Bear" + std::to_string(i), i * 20.0, 15.0, config.dungeon.bounds));
+            npcs.push_back(NPCFactory::createNPC("Desman", "Desman" + std::to_string(i), i * 20.0, 34.0, config.dungeon.bounds));
+        }
+        return npcs;
+    };
+
+    auto expected = runUnpartitioned(config, makeNPCs());
+    EXPECT_LT(expected.size(), 50u);
+    for (std::size_t workers : {std::size_t{1}, std::size_t{2}, std::size_t{3}}) {
+        config.workers = workers;
+        auto alive = PartitionedDungeon(config).run(makeNPCs(), {});
+        std::sort(alive.begin(), alive.end());
+        EXPECT_EQ(alive, expected) << workers << " workers";
+    }
+}
+
+// Параллельный бой
+TEST(ThreadPoolTest, RunsEveryIndexOnce) {
+    ThreadPool pool(4);
+    std::vector<int> hits(1000, 0);
+    pool.parallelFor(hits.size(), [&](std::size_t i) { ++hits[i]; });
+    EXPECT_TRUE(std::all_of(hits.begin(), hits.end(), [](int h) { return h == 1; }));
+    EXPECT_THROW(pool.parallelFor(10, [](std::size_t i) { if (i == 3) throw std::runtime_error("boom"); }), std::runtime_error);
+}
+
+TEST(DungeonTest, ParallelBattleIsDeterministic) {
+    DungeonConfig config;
+    config.bounds = WorldBounds{400.0, 400.0};
+    config.chunkSize = 10.0;
+
+    auto runBattle = [&](std::size_t threads, double range) {
+        Dungeon dungeon(config);
+        for (auto& npc : makeMixedNPCs(config.bounds, 2000)) {
+            dungeon.addNPC(std::move(npc));
+        }
+        auto counter = std::make_shared<CountingObserver>();
+        std::vector<std::shared_ptr<Observer>> observers = {counter};
+        dungeon.battle(range, observers, threads, 7);
+        auto alive = dungeon.survivors();
+        std::sort(alive.begin(), alive.end());
+        return std::make_pair(alive, counter->kills);
+    };
+
+    // 250 — радиус шире половины мира: раньше такой бой шёл в одном потоке
+    for (double range : {8.0, 250.0}) {
+        auto serial = runBattle(1, range);
+        auto parallel = runBattle(4, range);
+        EXPECT_EQ(serial.first, parallel.first) << range;
+        EXPECT_EQ(serial.second, parallel.second) << range;
+        EXPECT_FALSE(serial.second.empty()) << range;
+    }
+}
+
+// Инкрементальные контрольные точки
+namespace {
+std::vector<std::string> sortedPrint(const Dungeon& dungeon) {
+    CaptureOutput capture;
+    dungeon.print();
+    std::istringstream lines(capture.str());
+    std::vector<std::string> result;
+    for (std::string line; std::getline(lines, line);) {
+        result.push_back(line);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+}
+
+TEST(CheckpointTest, RestoreSnapshotPlusJournal) {
+    const std::string directory = "test_checkpoints";
+    std::filesystem::remove_all(directory);
+
+    DungeonConfig config;
+    config.bounds = WorldBounds{200.0, 200.0};
+    Dungeon dungeon(config);
+    auto victim = NPCFactory::createNPC("Bear", "Victim", 100.0, 100.0, config.bounds);
+    NPC* victimRaw = victim.get();
+    dungeon.addNPC(std::move(victim));
+    for (auto& npc : makeMixedNPCs(config.bounds, 60)) {
+        dungeon.addNPC(std::move(npc));
+    }
+
+    auto journal = std::make_shared<CheckpointJournal>(CheckpointConfig{directory, 3});
+    dungeon.setJournal(journal);
+    std::mt19937 rng(5);
+    for (int tick = 0; tick < 10; ++tick) {
+        dungeon.moveAll(rng);
+        if (tick == 7) {
+            victimRaw->kill();
+        }
+        dungeon.recordCheckpoint();
+    }
+    journal->flush();
+
+    // Старые поколения удалены, снимок есть
+    std::size_t snapshots = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        snapshots += entry.path().filename().string().rfind("snapshot.", 0) == 0;
+    }
+    EXPECT_EQ(snapshots, 1u);
+
+    Dungeon restored(config);
+    EXPECT_EQ(restored.restoreCheckpoint(directory), 61u);
+    EXPECT_EQ(sortedPrint(restored), sortedPrint(dungeon));
+    EXPECT_EQ(restored.survivors().size(), 60u);
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(CheckpointTest, TornJournalTailIsIgnored) {
+    const std::string directory = "test_checkpoints_torn";
+    std::filesystem::remove_all(directory);
+
+    Dungeon dungeon;
+    dungeon.addNPC(NPCFactory::createNPC("Bear", "Bear1", 10, 10));
+    dungeon.addNPC(NPCFactory::createNPC("Heron", "Heron1", 20, 20));
+    auto journal = std::make_shared<CheckpointJournal>(CheckpointConfig{directory, 100});
+    dungeon.setJournal(journal);
+    dungeon.recordCheckpoint();
+    journal->flush();
+
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        std::ofstream tail(entry.path(), std::ios::binary | std::ios::app);
+        tail.put(2);
+        tail.put(0);
+    }
+
+    Dungeon restored;
+    EXPECT_EQ(restored.restoreCheckpoint(directory), 2u);
+    EXPECT_EQ(sortedPrint(restored), sortedPrint(dungeon));
+
+    std::filesystem::remove_all(directory);
+}
+
+// Двоичный журнал событий
+TEST(EventLogTest, RoundTrip) {
+    const std::string filename = "test_events.bin";
+    std::uint64_t tick = 5;
+    auto bear = NPCFactory::createNPC("Bear", "Bear1", 1, 2);
+    auto heron = NPCFactory::createNPC("Heron", "Heron1", 3.5, 4.25);
+    auto desman = NPCFactory::createNPC("Desman", "Desman1", 6, 7);
+    {
+        BinaryEventLog log(filename, [&]() { return tick; });
+        log.onKillEvent(*bear, *heron);
+        tick = 9;
+        log.onKillEvent(*desman, *bear);
+        log.onKill("Killer1", "Victim1");
+    }
+
+    EventLogReader reader(filename);
+    std::vector<KillRecord> records;
+    EXPECT_EQ(reader.poll([&](const KillRecord& r) { records.push_back(r); }), 3u);
+    ASSERT_EQ(records.size(), 3u);
+    EXPECT_EQ(records[0].tick, 5u);
+    EXPECT_EQ(records[0].killerSpecies, Species::Bear);
+    EXPECT_EQ(records[0].victimSpecies, Species::Heron);
+    EXPECT_FLOAT_EQ(records[0].x, 3.5f);
+    EXPECT_FLOAT_EQ(records[0].y, 4.25f);
+    EXPECT_EQ(reader.nameOf(records[0].killerId), "Bear1");
+    EXPECT_EQ(reader.nameOf(records[1].killerId), "Desman1");
+    EXPECT_EQ(reader.nameOf(records[1].victimId), "Bear1");
+    EXPECT_EQ(records[1].tick, 9u);
+    EXPECT_EQ(reader.nameOf(records[2].victimId), "Victim1");
+
+    std::remove(filename.c_str());
+}
+
+// Файл читается по мере записи; неполная запись ждёт следующего poll
+TEST(EventLogTest, TailWhileWriting) {
+    const std::string filename = "test_events_tail.bin";
+    auto bear = NPCFactory::createNPC("Bear", "Bear1", 1, 2);
+    auto heron = NPCFactory::createNPC("Heron", "Heron1", 3, 4);
+
+    BinaryEventLog log(filename);
+    EventLogReader reader(filename);
+    log.onKillEvent(*bear, *heron);
+    EXPECT_EQ(reader.poll([](const KillRecord&) {}), 0u);
+    log.flush();
+    EXPECT_EQ(reader.poll([](const KillRecord&) {}), 1u);
+
+    {
+        std::ofstream partial(filename, std::ios::binary | std::ios::app);
+        partial.put(static_cast<char>(20));
+        partial.put(1);
+    }
+    EXPECT_EQ(reader.poll([](const KillRecord&) {}), 0u);
+
+    std::remove(filename.c_str());
+}
+
+// Длинное имя не роняет наблюдателя, а испорченный вид отвергается при чтении
+TEST(EventLogTest, LongNamesAndCorruptSpecies) {
+    const std::string filename = "test_events_corrupt.bin";
+    const std::string longName(300, 'B');
+    {
+        BinaryEventLog log(filename);
+        EXPECT_NO_THROW(log.onKill(longName, "Victim1"));
+    }
+    {
+        EventLogReader reader(filename);
+        std::vector<KillRecord> records;
+        EXPECT_EQ(reader.poll([&](const KillRecord& r) { records.push_back(r); }), 1u);
+        ASSERT_EQ(records.size(), 1u);
+        EXPECT_EQ(reader.nameOf(records[0].killerId), longName.substr(0, reader.nameOf(records[0].killerId).size()));
+        EXPECT_GT(reader.nameOf(records[0].killerId).size(), 200u);
+        EXPECT_EQ(reader.nameOf(records[0].victimId), "Victim1");
+    }
+
+    {
+        std::ofstream corrupt(filename, std::ios::binary | std::ios::app);
+        const char record[] = {12, 1, 9, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        corrupt.write(record, sizeof(record) - 1);
+    }
+    EventLogReader reader(filename);
+    EXPECT_THROW(reader.poll([](const KillRecord&) {}), std::runtime_error);
+
+    std::remove(filename.c_str());
+}
+
+// Буферизованный рендер карты
+TEST(MapRendererTest, PlainModeSkipsUnchangedFrames) {
+    RenderConfig config;
+    config.fd = -1;
+    MapRenderer renderer(config);
+    WorldBounds bounds;
+
+    renderer.beginFrame(bounds);
+    renderer.plot(10, 10, 'B');
+    EXPECT_GT(renderer.present(), 0u);
+    EXPECT_NE(renderer.frame().find("=== Map 50x50 ==="), std::string::npos);
+    EXPECT_NE(renderer.frame().find("[B]"), std::string::npos);
+
+    renderer.beginFrame(bounds);
+    renderer.plot(10, 10, 'B');
+    EXPECT_EQ(renderer.present(), 0u);
+}
+
+TEST(MapRendererTest, AnsiModeSendsChangedRowsOnly) {
+    RenderConfig config;
+    config.fd = -1;
+    config.ansiDiff = true;
+    MapRenderer renderer(config);
+    WorldBounds bounds;
+
+    renderer.beginFrame(bounds);
+    renderer.plot(10, 10, 'B');
+    renderer.present();
+
+    renderer.beginFrame(bounds);
+    renderer.plot(10, 10, 'B');
+    renderer.plot(30, 20, 'H');
+    renderer.present();
+    const std::string& diff = renderer.frame();
+    EXPECT_EQ(diff.find("==="), std::string::npos);
+    EXPECT_NE(diff.find("\x1b[22;1H"), std::string::npos);
+    EXPECT_EQ(std::count(diff.begin(), diff.end(), '\n'), 1);
+}
+
+// Размер вывода неизвестен (не терминал) — построчный режим не включается
+TEST(MapRendererTest, AnsiModeFallsBackWithoutTerminalSize) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    RenderConfig config;
+    config.fd = fds[1];
+    config.ansiDiff = true;
+    {
+        MapRenderer renderer(config);
+        EXPECT_FALSE(renderer.config().ansiDiff);
+        renderer.beginFrame(WorldBounds{});
+        renderer.plot(10, 10, 'B');
+        renderer.present();
+        EXPECT_EQ(renderer.frame().find('\x1b'), std::string::npos);
+    }
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(MapRendererTest, ViewportAndDownsampling) {
+    RenderConfig config;
+    config.fd = -1;
+    config.columns = 10;
+    config.rows = 10;
+    config.viewport = Viewport{100.0, 100.0, 100.0, 100.0};
+    MapRenderer renderer(config);
+
+    renderer.beginFrame(WorldBounds{1000.0, 1000.0});
+    renderer.plot(155.0, 105.0, 'B');
+    renderer.plot(156.0, 106.0, 'D');
+    renderer.plot(500.0, 500.0, 'H');
+    renderer.present();
+
+    std::istringstream lines(renderer.frame());
+    std::string line;
+    std::getline(lines, line);
+    std::getline(lines, line);
+    EXPECT_EQ(line.substr(15, 3), "[*]");
+    EXPECT_EQ(renderer.frame().find('H'), std::string::npos);
+}
+
+TEST(DungeonTest, PrintMapSkipsWhenWorldUnchanged) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    Dungeon dungeon;
+    dungeon.addNPC(NPCFactory::createNPC("Bear", "Bear1", 10, 10));
+    RenderConfig config;
+    config.fd = fds[1];
+    dungeon.setRenderConfig(config);
+
+    char buffer[8192];
+    dungeon.printMap();
+    EXPECT_GT(read(fds[0], buffer, sizeof(buffer)), 0);
+    dungeon.printMap();
+    EXPECT_LT(read(fds[0], buffer, sizeof(buffer)), 0);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// Адаптивный темп тиков
+TEST(TickPacerTest, StretchesWhenBattleIsBehind) {
+    using namespace std::chrono_literals;
+    PacingConfig config;
+    config.targetTick = 100ms;
+    config.maxTick = 400ms;
+    config.queueCapacity = 100;
+    TickPacer pacer(config);
+
+    EXPECT_TRUE(pacer.shouldScan(10));
+    EXPECT_FALSE(pacer.shouldScan(60));
+
+    auto sleep = pacer.nextInterval(0ms, 60);
+    EXPECT_EQ(sleep, 150ms);
+    for (int i = 0; i < 10; ++i) {
+        sleep = pacer.nextInterval(0ms, 60);
+    }
+    EXPECT_EQ(sleep, 400ms);
+
+    // Очередь разобрана — интервал возвращается к цели, работа тика вычитается
+    for (int i = 0; i < 20; ++i) {
+        sleep = pacer.nextInterval(30ms, 0);
+    }
+    EXPECT_EQ(sleep, 70ms);
+
+    auto stats = pacer.stats();
+    EXPECT_EQ(stats.ticks, 2u);
+    EXPECT_EQ(stats.skippedScans, 1u);
+    EXPECT_EQ(stats.interval, 100ms);
+}
+
+TEST(TickPacerTest, SlowBattleStretchesInterval) {
+    using namespace std::chrono_literals;
+    PacingConfig config;
+    config.targetTick = 100ms;
+    config.queueCapacity = 100;
+    TickPacer pacer(config);
+    for (int i = 0; i < 50; ++i) {
+        pacer.recordBattleLatency(1s);
+    }
+    // Очередь ниже верхней отметки, но бои разбираются медленно
+    EXPECT_GT(pacer.nextInterval(0ms, 20), 100ms);
+
+    // Очередь разобрана и новых боёв нет: старая задержка забывается
+    std::chrono::milliseconds sleep{};
+    for (int i = 0; i < 100; ++i) {
+        sleep = pacer.nextInterval(0ms, 0);
+    }
+    EXPECT_EQ(sleep, 100ms);
+    EXPECT_LT(pacer.stats().battleLatency, 50ms);
+    EXPECT_THROW(TickPacer(PacingConfig{0ms}), std::invalid_argument);
+}
+
+// Без потока боя очередь не растёт сверх ёмкости
+TEST(DungeonTest, FightQueueIsBounded) {
+    using namespace std::chrono_literals;
+    DungeonConfig config;
+    config.pacing.targetTick = 10ms;
+    config.pacing.queueCapacity = 8;
+    Dungeon dungeon(config);
+    for (int i = 0; i < 20; ++i) {
+        dungeon.addNPC(NPCFactory::createNPC(i % 2 ? "Bear" : "Desman", "NPC" + std::to_string(i), 25, 25));
+    }
+
+    std::atomic<bool> stopFlag{false};
+    std::thread movement = dungeon.startMovementThread(stopFlag);
+    std::this_thread::sleep_for(100ms);
+    stopFlag.store(true);
+    movement.join();
+
+    EXPECT_LE(dungeon.fightQueueDepth(), 8u);
+    auto stats = dungeon.pacingStats();
+    EXPECT_GT(stats.droppedFights, 0u);
+    EXPECT_GT(stats.skippedScans, 0u);
+    EXPECT_GT(stats.interval, 10ms);
+}
+
+// Захваты разносятся по местам вызова; выключенный профиль ничего не копит
+TEST(LockProfileTest, AttributesAcquisitionsToSites) {
+    Dungeon dungeon;
+    dungeon.addNPC(NPCFactory::createNPC("Bear", "Bear1", 10, 10));
+    EXPECT_TRUE(dungeon.lockProfile().empty());
+
+    dungeon.enableLockProfiling();
+    dungeon.addNPC(NPCFactory::createNPC("Heron", "Heron1", 20, 20));
+    dungeon.survivors();
+    dungeon.survivors();
+    dungeon.maxKillDistance();
+
+    auto countOf = [&](LockSite site) {
+        std::uint64_t count = 0;
+        for (const auto& row : dungeon.lockProfile()) {
+            if (row.mutex == "npcsMutex_" && row.site == site) count += row.acquisitions;
+        }
+        return count;
+    };
+    EXPECT_EQ(countOf(LockSite::AddNPC), 1u);
+    EXPECT_EQ(countOf(LockSite::Survivors), 2u);
+    EXPECT_EQ(countOf(LockSite::Other), 1u);
+
+    dungeon.enableLockProfiling(false);
+    dungeon.survivors();
+    EXPECT_EQ(countOf(LockSite::Survivors), 2u);
+
+    std::ostringstream out;
+    dungeon.dumpLockProfile(out);
+    EXPECT_NE(out.str().find("survivors"), std::string::npos);
+}
+
+TEST(LockProfileTest, HistogramPercentiles) {
+    using namespace std::chrono_literals;
+    LockProfile profile("test");
+    for (int i = 0; i < 99; ++i) {
+        profile.recordWait(LockSite::Other, 100ns);
+        profile.recordHold(LockSite::Other, 100ns);
+    }
+    profile.recordWait(LockSite::Other, 1ms);
+    profile.recordHold(LockSite::Other, 1ms);
+
+    auto stats = profile.snapshot();
+    ASSERT_EQ(stats.size(), 1u);
+    EXPECT_EQ(stats[0].acquisitions, 100u);
+    EXPECT_EQ(stats[0].waitPercentile(0.5), 127ns);
+    EXPECT_GE(stats[0].holdPercentile(1.0), 1ms);
+    EXPECT_LT(stats[0].holdPercentile(1.0), 2ms);
+    EXPECT_EQ(stats[0].totalWait, 99 * 100ns + 1ms);
+}
+
+// Кадры читаются обратно с точностью до шага квантования, смерть видна в маске
+TEST(TrajectoryTest, RoundTripAcrossBlocks) {
+    const std::string path = "trajectory_test.bin";
+    TrajectoryConfig config;
+    config.filename = path;
+    config.framesPerBlock = 3;
+    auto bear = NPCFactory::createNPC("Bear", "Bear1", 10, 10);
+    auto heron = NPCFactory::createNPC("Heron", "Heron1", 40, 5);
+    {
+        TrajectoryRecorder recorder(config);
+        for (std::uint64_t tick = 0; tick < 7; ++tick) {
+            recorder.beginFrame(tick * 2);
+            recorder.record(*bear);
+            if (tick >= 2) {
+                recorder.record(*heron);
+            }
+            recorder.endFrame();
+            bear->moveBy(0.3, -0.2);
+            if (tick == 4) {
+                heron->kill();
+            }
+        }
+    }
+
+    TrajectoryReader reader(path);
+    TrajectoryFrame frame;
+    std::vector<TrajectoryFrame> frames;
+    while (reader.next(frame)) {
+        frames.push_back(frame);
+    }
+    ASSERT_EQ(frames.size(), 7u);
+    ASSERT_EQ(reader.npcCount(), 2u);
+    EXPECT_EQ(reader.nameOf(1), "Heron1");
+    EXPECT_EQ(reader.typeOf(0), "Bear");
+    EXPECT_EQ(frames[6].tick, 12u);
+    EXPECT_NEAR(frames[6].x[0], 10 + 6 * 0.3, config.quantum);
+    EXPECT_NEAR(frames[6].y[0], 10 - 6 * 0.2, config.quantum);
+    EXPECT_FALSE(frames[0].alive[1]);
+    EXPECT_TRUE(frames[4].alive[1]);
+    EXPECT_FALSE(frames[5].alive[1]);
+    EXPECT_NEAR(frames[5].x[1], 40, config.quantum);
+    std::filesystem::remove(path);
+}
+
+TEST(TrajectoryTest, RecordsFromMovementLoop) {
+    using namespace std::chrono_literals;
+    const std::string path = "trajectory_dungeon.bin";
+    DungeonConfig dungeonConfig;
+    dungeonConfig.pacing.targetTick = 5ms;
+    Dungeon dungeon(dungeonConfig);
+    for (auto& npc : makeMixedNPCs(dungeonConfig.bounds, 200)) {
+        dungeon.addNPC(std::move(npc));
+    }
+    TrajectoryConfig config;
+    config.filename = path;
+    config.sampleEvery = 2;
+    auto recorder = std::make_shared<TrajectoryRecorder>(config);
+    dungeon.setTrajectoryRecorder(recorder);
+
+    std::atomic<bool> stopFlag{false};
+    std::thread movement = dungeon.startMovementThread(stopFlag);
+    std::this_thread::sleep_for(100ms);
+    stopFlag.store(true);
+    movement.join();
+    recorder->flush();
+
+    TrajectoryReader reader(path);
+    TrajectoryFrame frame;
+    std::size_t count = 0;
+    while (reader.next(frame)) {
+        EXPECT_EQ(frame.tick % 2, 0u);
+        EXPECT_EQ(frame.x.size(), 200u);
+        ++count;
+    }
+    EXPECT_GT(count, 0u);
+    EXPECT_GT(std::filesystem::file_size(path), 0u);
+    std::filesystem::remove(path);
+}
+
+// Выпи и выхухоли не дерутся друг с другом: все спят, очередь боёв пуста.
+// Медведь рядом будит соседей
+TEST(DungeonTest, SleepingNPCsSkipPairWork) {
+    std::mt19937 rng(3);
+    Dungeon peaceful;
+    for (int i = 0; i < 30; ++i) {
+        peaceful.addNPC(NPCFactory::createNPC(i % 2 ? "Heron" : "Desman", "NPC" + std::to_string(i), 25, 25));
+    }
+    for (int tick = 0; tick < 3; ++tick) {
+        peaceful.movementTick(rng);
+    }
+    EXPECT_EQ(peaceful.sleepingNPCs(), 30u);
+    EXPECT_EQ(peaceful.fightQueueDepth(), 0u);
+
+    Dungeon mixed;
+    for (int i = 0; i < 30; ++i) {
+        mixed.addNPC(NPCFactory::createNPC(i % 3 == 0 ? "Bear" : "Heron", "NPC" + std::to_string(i), 25, 25));
+    }
+    mixed.movementTick(rng);
+    EXPECT_LT(mixed.sleepingNPCs(), 30u);
+    EXPECT_GT(mixed.fightQueueDepth(), 0u);
+}
+
+// Пакетный бой: каждый погибший убит ровно один раз, очередь выбрана до конца
+TEST(DungeonTest, BatchedBattleKillsEachVictimOnce) {
+    DungeonConfig config;
+    config.fightBatch = 8;
+    Dungeon dungeon(config);
+    for (int i = 0; i < 40; ++i) {
+        dungeon.addNPC(NPCFactory::createNPC(i % 2 ? "Bear" : "Desman", "NPC" + std::to_string(i), 25, 25));
+    }
+
+    std::mt19937 rng(5);
+    for (int tick = 0; tick < 3; ++tick) {
+        dungeon.movementTick(rng);
+    }
+    ASSERT_GT(dungeon.fightQueueDepth(), 8u);
+
+    // Движение остановлено: поток боя разбирает очередь до конца и выходит
+    std::atomic<bool> stopFlag{true};
+    auto counter = std::make_shared<CountingObserver>();
+    std::thread battle = dungeon.startBattleThread(stopFlag, {counter});
+    battle.join();
+
+    EXPECT_EQ(dungeon.fightQueueDepth(), 0u);
+    const std::size_t dead = 40 - dungeon.survivors().size();
+    EXPECT_GT(dead, 0u);
+    EXPECT_EQ(counter->kills.size(), dead);
+}
+
+// Сортировка по x находит те же пары, что и сетка, в том числе после
+// движения, когда список досортировывается вставками
+TEST(DungeonTest, SweepAndPruneMatchesGrid) {
+    WorldBounds bounds{200, 200};
+    auto pairsOf = [&](Broadphase broadphase) {
+        DungeonConfig config;
+        config.bounds = bounds;
+        config.broadphase = broadphase;
+        Dungeon dungeon(config);
+        for (auto& npc : makeMixedNPCs(bounds, 300)) {
+            dungeon.addNPC(std::move(npc));
+        }
+        std::mt19937 rng(11);
+        std::vector<std::vector<std::string>> rounds;
+        for (int round = 0; round < 3; ++round) {
+            std::vector<std::string> pairs;
+            dungeon.forEachPairInRange(12.0, [&](NPC& a, NPC& b) {
+                pairs.push_back(std::min(a.getName(), b.getName()) + "-" + std::max(a.getName(), b.getName()));
+            });
+            std::sort(pairs.begin(), pairs.end());
+            rounds.push_back(pairs);
+            dungeon.moveAll(rng);
+        }
+        return rounds;
+    };
+
+    auto grid = pairsOf(Broadphase::Grid);
+    auto sweep = pairsOf(Broadphase::SweepAndPrune);
+    ASSERT_FALSE(grid[0].empty());
+    EXPECT_EQ(grid, sweep);
+}
+
+// Ленивая загрузка: после запроса ко всему миру он тот же, что и при полной загрузке
+TEST(DungeonTest, LazyLoadMatchesEagerLoad) {
+    const std::string path = "regions_test.bin";
+    DungeonConfig config;
+    config.bounds = WorldBounds{400.0, 400.0};
+    config.snapshotRegionSize = 50.0;
+    Dungeon original(config);
+    for (auto& npc : makeMixedNPCs(config.bounds, 500)) {
+        original.addNPC(std::move(npc));
+    }
+    original.saveRegionSnapshot(path);
+    ASSERT_TRUE(RegionSnapshot::isSnapshot(path));
+    EXPECT_GT(RegionSnapshot(path).regions().size(), 1u);
+
+    Dungeon lazy(config);
+    EXPECT_EQ(lazy.loadLazy(path), 500u);
+    EXPECT_GT(lazy.dormantRegions(), 0u);
+    EXPECT_EQ(lazy.maxKillDistance(), original.maxKillDistance());
+    EXPECT_EQ(sortedPrint(lazy), sortedPrint(original));
+    // Запрос только будит области: забирает их тик движения
+    std::mt19937 rng(3);
+    lazy.movementTick(rng);
+    EXPECT_EQ(lazy.dormantRegions(), 0u);
+    std::filesystem::remove(path);
+}
+
+// Мир будится только вокруг запрошенного: области за пределами досягаемости боя
+// спят, а бой через границу области, разбуженной на этом тике, находится сразу
+TEST(DungeonTest, LazyWorldWakesOnlyNearActivity) {
+    using namespace std::chrono_literals;
+    const std::string path = "regions_running.bin";
+    DungeonConfig config;
+    config.bounds = WorldBounds{400.0, 40.0};
+    config.snapshotRegionSize = 50.0;
+    {
+        Dungeon original(config);
+        // Медведь у границы запрошенной области 0 будит область 1, выхухоль в ней — область 2
+        original.addNPC(NPCFactory::createNPC("Bear", "Edge", 45.0, 20.0, config.bounds));
+        original.addNPC(NPCFactory::createNPC("Desman", "Hunter", 98.0, 20.0, config.bounds));
+        original.addNPC(NPCFactory::createNPC("Bear", "Prey", 102.0, 20.0, config.bounds));
+        original.addNPC(NPCFactory::createNPC("Heron", "Far", 375.0, 20.0, config.bounds));
+        original.saveRegionSnapshot(path);
+    }
+
+    Dungeon lazy(config);
+    ASSERT_EQ(lazy.loadLazy(path), 4u);
+    ASSERT_EQ(lazy.dormantRegions(), 4u);
+    RenderConfig render;
+    render.viewport = Viewport{0.0, 0.0, 40.0, 40.0};
+    render.fd = -1;
+    lazy.setRenderConfig(render);
+    lazy.printMap();
+
+    std::mt19937 rng(11);
+    std::size_t fightsWhenWoken = 0;
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (lazy.dormantRegions() > 1 && std::chrono::steady_clock::now() < deadline) {
+        lazy.movementTick(rng);
+        fightsWhenWoken = lazy.fightQueueDepth();
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_EQ(lazy.dormantRegions(), 1u);
+    EXPECT_GT(fightsWhenWoken, 0u);
+    EXPECT_EQ(lazy.survivors().size(), 4u);
+    std::filesystem::remove(path);
+}
+
+// Снимок журнала удаляет прежние поколения, поэтому в ленивом мире он содержит и спящие области
+TEST(CheckpointTest, LazyWorldSnapshotIsComplete) {
+    const std::string path = "regions_journal.bin";
+    const std::string directory = "test_checkpoints_lazy";
+    std::filesystem::remove_all(directory);
+    DungeonConfig config;
+    config.bounds = WorldBounds{400.0, 400.0};
+    config.snapshotRegionSize = 10.0;
+    {
+        Dungeon original(config);
+        for (auto& npc : makeMixedNPCs(config.bounds, 500)) {
+            original.addNPC(std::move(npc));
+        }
+        original.saveRegionSnapshot(path);
+    }
+
+    Dungeon lazy(config);
+    ASSERT_EQ(lazy.loadLazy(path), 500u);
+    auto journal = std::make_shared<CheckpointJournal>(CheckpointConfig{directory, 1});
+    lazy.setJournal(journal);
+    std::mt19937 rng(5);
+    lazy.movementTick(rng);
+    journal->flush();
+    EXPECT_EQ(lazy.dormantRegions(), 0u);
+
+    Dungeon restored(config);
+    EXPECT_EQ(restored.restoreCheckpoint(directory), 500u);
+    std::filesystem::remove_all(directory);
+    std::filesystem::remove(path);
+}
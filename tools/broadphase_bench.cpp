@@ -0,0 +1,137 @@
+#include "dungeon.hpp"
+#include "factory.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Сравнение способов поиска пар соседей на равномерном и скученном мире:
+//   broadphase_bench [npcs] [ticks]
+// Для каждого способа — время одного поиска пар и среднее время тика
+// (движение + поиск пар). Полный перебор всех пар — точка отсчёта.
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr double WORLD_SIZE = 1000.0;
+constexpr std::size_t CLUSTERS = 8;
+constexpr double CLUSTER_SPREAD = 15.0;
+
+std::vector<std::unique_ptr<NPC>> makeWorld(std::size_t count, bool clustered, std::uint32_t seed) {
+    const WorldBounds bounds{WORLD_SIZE, WORLD_SIZE};
+    const std::vector<std::string> types = {"Bear", "Heron", "Desman"};
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, WORLD_SIZE);
+    std::normal_distribution<double> spread(0.0, CLUSTER_SPREAD);
+
+    std::vector<std::pair<double, double>> centres;
+    for (std::size_t i = 0; i < CLUSTERS; ++i) {
+        centres.emplace_back(uniform(rng), uniform(rng));
+    }
+
+    std::vector<std::unique_ptr<NPC>> npcs;
+    for (std::size_t i = 0; i < count; ++i) {
+        double x = uniform(rng);
+        double y = uniform(rng);
+        if (clustered) {
+            const auto& centre = centres[i % CLUSTERS];
+            x = std::clamp(centre.first + spread(rng), 0.0, WORLD_SIZE);
+            y = std::clamp(centre.second + spread(rng), 0.0, WORLD_SIZE);
+        }
+        const std::string& type = types[i % types.size()];
+        npcs.push_back(NPCFactory::createNPC(type, type + std::to_string(i), x, y, bounds));
+    }
+    return npcs;
+}
+
+double millisSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct Result {
+    std::size_t pairs;
+    double scanMs;
+    double tickMs;
+};
+
+Result runDungeon(Broadphase broadphase, std::size_t count, bool clustered, std::size_t ticks) {
+    DungeonConfig config;
+    config.bounds = WorldBounds{WORLD_SIZE, WORLD_SIZE};
+    config.broadphase = broadphase;
+    Dungeon dungeon(config);
+    for (auto& npc : makeWorld(count, clustered, 42)) {
+        dungeon.addNPC(std::move(npc));
+    }
+    const double range = dungeon.maxKillDistance();
+
+    // Первый поиск строит структуры; замеряется второй
+    std::size_t pairs = 0;
+    dungeon.forEachPairInRange(range, [&](NPC&, NPC&) { ++pairs; });
+    pairs = 0;
+    auto start = Clock::now();
+    dungeon.forEachPairInRange(range, [&](NPC&, NPC&) { ++pairs; });
+    const double scanMs = millisSince(start);
+
+    std::mt19937 rng(7);
+    std::size_t sink = 0;
+    start = Clock::now();
+    for (std::size_t t = 0; t < ticks; ++t) {
+        dungeon.moveAll(rng);
+        dungeon.forEachPairInRange(range, [&](NPC&, NPC&) { ++sink; });
+    }
+    const double tickMs = ticks > 0 ? millisSince(start) / static_cast<double>(ticks) : 0.0;
+    return Result{pairs, scanMs, tickMs};
+}
+
+Result runBruteForce(std::size_t count, bool clustered) {
+    auto npcs = makeWorld(count, clustered, 42);
+    double range = 0.0;
+    for (const auto& npc : npcs) {
+        range = std::max(range, npc->getKillDistance());
+    }
+
+    std::size_t pairs = 0;
+    const auto start = Clock::now();
+    for (std::size_t i = 0; i < npcs.size(); ++i) {
+        for (std::size_t j = i + 1; j < npcs.size(); ++j) {
+            if (npcs[i]->distanceTo(*npcs[j]) <= range) {
+                ++pairs;
+            }
+        }
+    }
+    return Result{pairs, millisSince(start), 0.0};
+}
+
+void printRow(const std::string& world, const std::string& method, const Result& result) {
+    std::cout << std::left << std::setw(11) << world << std::setw(16) << method << std::right
+              << std::setw(12) << result.pairs << std::fixed << std::setprecision(2)
+              << std::setw(12) << result.scanMs;
+    if (result.tickMs > 0.0) {
+        std::cout << std::setw(12) << result.tickMs;
+    } else {
+        std::cout << std::setw(12) << "-";
+    }
+    std::cout << std::endl;
+}
+}
+
+int main(int argc, char** argv) {
+    const std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+    const std::size_t ticks = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10;
+
+    std::cout << count << " NPCs, world " << WORLD_SIZE << "x" << WORLD_SIZE << ", " << ticks << " ticks" << std::endl;
+    std::cout << std::left << std::setw(11) << "world" << std::setw(16) << "method" << std::right
+              << std::setw(12) << "pairs" << std::setw(12) << "scan ms" << std::setw(12) << "tick ms" << std::endl;
+
+    for (bool clustered : {false, true}) {
+        const std::string world = clustered ? "clustered" : "uniform";
+        printRow(world, "brute force", runBruteForce(count, clustered));
+        printRow(world, "grid", runDungeon(Broadphase::Grid, count, clustered, ticks));
+        printRow(world, "sweep&prune", runDungeon(Broadphase::SweepAndPrune, count, clustered, ticks));
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "event_log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+
+// Офлайн-анализ двоичного журнала убийств:
+//   replay_events <events.bin> [--bucket N] [--follow]
+// С --follow отчёт печатается после каждой порции новых записей,
+// по Ctrl+C — итоговый отчёт и выход
+namespace {
+volatile std::sig_atomic_t interrupted = 0;
+
+struct Report {
+    std::array<std::array<std::uint64_t, SPECIES_COUNT>, SPECIES_COUNT> matrix{};
+    std::map<std::uint64_t, std::uint64_t> series;
+    std::uint64_t total = 0;
+};
+
+void printReport(const Report& report, std::uint64_t bucket, double seconds) {
+    std::cout << "=== Kills by species (killer -> victim) ===" << std::endl;
+    for (std::size_t k = 0; k < SPECIES_COUNT; ++k) {
+        for (std::size_t v = 0; v < SPECIES_COUNT; ++v) {
+            if (report.matrix[k][v] == 0) continue;
+            std::cout << speciesName(static_cast<Species>(k)) << " -> " << speciesName(static_cast<Species>(v)) << ": " << report.matrix[k][v] << std::endl;
+        }
+    }
+
+    std::cout << "=== Kills per " << bucket << " ticks ===" << std::endl;
+    for (const auto& [index, kills] : report.series) {
+        std::cout << index * bucket << "\t" << kills << std::endl;
+    }
+
+    std::cout << "Total kills: " << report.total << " (" << seconds << " s)" << std::endl;
+}
+}
+
+int main(int argc, char** argv) {
+    using namespace std::chrono_literals;
+
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <events.bin> [--bucket N] [--follow]" << std::endl;
+        return 1;
+    }
+
+    std::string filename = argv[1];
+    std::uint64_t bucket = 10;
+    bool follow = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--bucket" && i + 1 < argc) {
+            bucket = std::max<std::uint64_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--follow") {
+            follow = true;
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    Report report;
+    const auto start = std::chrono::steady_clock::now();
+    auto seconds = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+    try {
+        EventLogReader reader(filename);
+        auto consume = [&](const KillRecord& record) {
+            ++report.matrix[static_cast<std::size_t>(record.killerSpecies)][static_cast<std::size_t>(record.victimSpecies)];
+            ++report.series[record.tick / bucket];
+            ++report.total;
+        };
+        if (!follow) {
+            reader.poll(consume);
+        } else {
+            std::signal(SIGINT, [](int) { interrupted = 1; });
+            while (!interrupted) {
+                if (reader.poll(consume) > 0) {
+                    printReport(report, bucket, seconds());
+                } else {
+                    std::this_thread::sleep_for(200ms);
+                }
+            }
+            std::cout << "=== Final ===" << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    printReport(report, bucket, seconds());
+    return 0;
+}